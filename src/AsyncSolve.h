@@ -0,0 +1,59 @@
+#pragma once
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <utility>
+
+#ifndef __EMSCRIPTEN__
+#include <thread>
+#endif
+
+#include "Budget.h"
+
+// Runs a task of an asynchronous solver call, for example by posting it to a thread pool
+using Executor = std::function<void(std::function<void()>)>;
+
+// Handle of an asynchronous solver call
+template <typename Result>
+class SolveHandle {
+public:
+    SolveHandle(std::future<Result> future, std::shared_ptr<CancellationToken> cancellation)
+        : future_(std::move(future)), cancellation_(std::move(cancellation)) {}
+
+    // Makes the call finish soon, with `kUnknown` unless it has already completed
+    void Cancel() { cancellation_->Cancel(); }
+
+    // Completion of the call
+    std::future<Result>& future() { return future_; }
+
+private:
+    std::future<Result> future_;
+    std::shared_ptr<CancellationToken> cancellation_;
+};
+
+// Runs `solve` on `executor` (on a new thread if it is null, or right away under Emscripten). `solve` is given `budget`
+// with a cancellation token of the returned handle, which is also cancelled by `budget.cancellation` if any. The time
+// limit counts from the start of the task.
+template <typename Result>
+SolveHandle<Result> StartSolveAsync(std::function<Result(const SolveBudget&)> solve, const SolveBudget& budget,
+                                    const Executor& executor) {
+    auto cancellation = std::make_shared<CancellationToken>(budget.cancellation);
+    SolveBudget task_budget = budget;
+    task_budget.cancellation = cancellation.get();
+
+    auto task = std::make_shared<std::packaged_task<Result()>>(
+        [solve = std::move(solve), task_budget, cancellation]() { return solve(task_budget); });
+    std::future<Result> future = task->get_future();
+    std::function<void()> run = [task]() { (*task)(); };
+    if (executor) {
+        executor(std::move(run));
+    } else {
+#ifdef __EMSCRIPTEN__
+        run();
+#else
+        std::thread(std::move(run)).detach();
+#endif
+    }
+    return SolveHandle<Result>(std::move(future), std::move(cancellation));
+}
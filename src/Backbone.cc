@@ -0,0 +1,306 @@
+#include "Backbone.h"
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+
+#ifndef __EMSCRIPTEN__
+#include <deque>
+#include <mutex>
+#include <thread>
+#endif
+
+namespace {
+
+constexpr int kInitialChunkSize = 8;
+constexpr int kMaxChunkSize = 256;
+
+std::vector<Glucose::Lit> InitialCandidates(const Glucose::Solver& solver, const std::vector<Glucose::Var>& vars) {
+    std::vector<Glucose::Lit> candidates;
+    for (Glucose::Var v : vars) {
+        assert(solver.modelValue(v) != l_Undef);
+        candidates.push_back(Glucose::mkLit(v, solver.modelValue(v) == l_False));
+    }
+    return candidates;
+}
+
+// Runs `solver` under the condition that at least one of `chunk` is false. Returns l_True if a model is found, in which
+// case the chunk is not in the backbone, and l_Undef if the run is stopped.
+Glucose::lbool SolveForChunk(Glucose::Solver& solver, const std::vector<Glucose::Lit>& chunk) {
+    assert(!chunk.empty());
+    Glucose::vec<Glucose::Lit> assumptions;
+    if (chunk.size() == 1) {
+        assumptions.push(~chunk[0]);
+        return solver.solveLimited(assumptions);
+    }
+
+    Glucose::Var activation = solver.newVar();
+    Glucose::vec<Glucose::Lit> clause;
+    clause.push(Glucose::mkLit(activation, true));
+    for (Glucose::Lit lit : chunk) {
+        clause.push(~lit);
+    }
+    solver.addClause(clause);
+    assumptions.push(Glucose::mkLit(activation, false));
+
+    Glucose::lbool res = solver.solveLimited(assumptions);
+    solver.addClause(Glucose::mkLit(activation, true));
+    return res;
+}
+
+#ifndef __EMSCRIPTEN__
+
+class ParallelBackbone {
+public:
+    ParallelBackbone(std::vector<Glucose::Lit> candidates, int num_workers, BackboneObserver* observer)
+        : candidates_(std::move(candidates)), status_(candidates_.size(), kUndecided), queues_(num_workers),
+          num_open_(candidates_.size()), stopped_(false), observer_(observer) {
+        // Contiguous slices, so that steals (from the back) and own work (from the front) rarely meet
+        int n = candidates_.size();
+        for (int w = 0; w < num_workers; ++w) {
+            for (int i = (long long)n * w / num_workers; i < (long long)n * (w + 1) / num_workers; ++i) {
+                queues_[w].push_back(i);
+            }
+        }
+        if (observer_ != nullptr) {
+            observer_->OnProgress(num_open_, 0);
+        }
+    }
+
+    void Run(Glucose::Solver& solver, int worker);
+
+    std::vector<Glucose::Lit> backbone() const {
+        std::vector<Glucose::Lit> ret;
+        for (int i : backbone_) {
+            ret.push_back(candidates_[i]);
+        }
+        return ret;
+    }
+
+    bool stopped() const { return stopped_; }
+
+private:
+    enum Status {
+        kUndecided,
+        kInProgress,
+        kBackbone,
+        kRefuted,
+    };
+
+    // Takes at most `max_size` undecided candidates into `chunk`, first from the queue of `worker`, and then from the
+    // other queues. Returns false if there is no undecided candidate left. `mutex_` must be held.
+    bool TakeChunk(int worker, int max_size, std::vector<int>& chunk);
+
+    std::mutex mutex_;
+    std::vector<Glucose::Lit> candidates_;
+    std::vector<Status> status_;
+    std::vector<std::deque<int>> queues_;
+    std::vector<int> backbone_; // in the order of proof
+    int num_open_;              // candidates neither proven nor refuted
+    bool stopped_;              // whether a run ended without an answer
+    BackboneObserver* observer_;
+};
+
+bool ParallelBackbone::TakeChunk(int worker, int max_size, std::vector<int>& chunk) {
+    chunk.clear();
+    int num_workers = queues_.size();
+    for (int k = 0; k < num_workers && (int)chunk.size() < max_size; ++k) {
+        std::deque<int>& queue = queues_[(worker + k) % num_workers];
+        bool is_own = k == 0;
+        while (!queue.empty() && (int)chunk.size() < max_size) {
+            int i;
+            if (is_own) {
+                i = queue.front();
+                queue.pop_front();
+            } else {
+                i = queue.back();
+                queue.pop_back();
+            }
+            if (status_[i] == kUndecided) {
+                status_[i] = kInProgress;
+                chunk.push_back(i);
+            }
+        }
+    }
+    return !chunk.empty();
+}
+
+void ParallelBackbone::Run(Glucose::Solver& solver, int worker) {
+    int chunk_size = kInitialChunkSize;
+    int num_imported = 0;
+    std::vector<int> chunk;
+    std::vector<Glucose::Lit> chunk_lits;
+    std::vector<Glucose::Lit> new_units;
+
+    for (;;) {
+        new_units.clear();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (; num_imported < (int)backbone_.size(); ++num_imported) {
+                new_units.push_back(candidates_[backbone_[num_imported]]);
+            }
+            if (stopped_ || !TakeChunk(worker, chunk_size, chunk)) {
+                break;
+            }
+        }
+        for (Glucose::Lit lit : new_units) {
+            solver.addClause(lit);
+        }
+
+        chunk_lits.clear();
+        for (int i : chunk) {
+            chunk_lits.push_back(candidates_[i]);
+        }
+        Glucose::lbool res = SolveForChunk(solver, chunk_lits);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (res == l_Undef) {
+            stopped_ = true;
+            break;
+        }
+        if (res == l_True) {
+            // Broadcast the model: no worker needs to test the candidates it refutes
+            for (int i = 0; i < (int)candidates_.size(); ++i) {
+                if ((status_[i] == kUndecided || status_[i] == kInProgress) &&
+                    solver.modelValue(candidates_[i]) != l_True) {
+                    status_[i] = kRefuted;
+                    --num_open_;
+                    if (observer_ != nullptr) {
+                        observer_->OnRefuted(candidates_[i]);
+                    }
+                }
+            }
+            for (auto it = chunk.rbegin(); it != chunk.rend(); ++it) {
+                if (status_[*it] == kInProgress) {
+                    status_[*it] = kUndecided;
+                    queues_[worker].push_front(*it);
+                }
+            }
+            chunk_size = std::max(chunk_size / 2, 1);
+        } else {
+            for (int i : chunk) {
+                assert(status_[i] == kInProgress);
+                status_[i] = kBackbone;
+                backbone_.push_back(i);
+                --num_open_;
+                if (observer_ != nullptr) {
+                    observer_->OnProven(candidates_[i]);
+                }
+            }
+            // The units are added to the own solver in the next iteration
+            chunk_size = std::min(chunk_size * 2, kMaxChunkSize);
+        }
+        if (observer_ != nullptr) {
+            observer_->OnProgress(num_open_, backbone_.size());
+        }
+    }
+}
+
+#endif
+
+} // namespace
+
+std::vector<Glucose::Lit> ComputeBackbone(Glucose::Solver& solver, const std::vector<Glucose::Var>& vars,
+                                          bool* complete, BackboneObserver* observer) {
+    std::vector<Glucose::Lit> candidates = InitialCandidates(solver, vars);
+    std::vector<Glucose::Lit> backbone;
+    std::vector<Glucose::Lit> chunk;
+    int chunk_size = kInitialChunkSize;
+
+    for (;;) {
+        // Literals fixed at the top level need no search
+        candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+                                        [&](Glucose::Lit lit) {
+                                            if (solver.value(lit) == l_True) {
+                                                backbone.push_back(lit);
+                                                if (observer != nullptr) {
+                                                    observer->OnProven(lit);
+                                                }
+                                                return true;
+                                            }
+                                            return false;
+                                        }),
+                         candidates.end());
+        if (observer != nullptr) {
+            observer->OnProgress(candidates.size(), backbone.size());
+        }
+        if (candidates.empty()) {
+            break;
+        }
+
+        int n = std::min<int>(chunk_size, candidates.size());
+        chunk.assign(candidates.end() - n, candidates.end());
+
+        Glucose::lbool res = SolveForChunk(solver, chunk);
+        if (res == l_Undef) {
+            if (complete != nullptr) {
+                *complete = false;
+            }
+            return backbone;
+        }
+        if (res == l_True) {
+            candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+                                            [&](Glucose::Lit lit) {
+                                                if (solver.modelValue(lit) != l_True) {
+                                                    if (observer != nullptr) {
+                                                        observer->OnRefuted(lit);
+                                                    }
+                                                    return true;
+                                                }
+                                                return false;
+                                            }),
+                             candidates.end());
+            chunk_size = std::max(chunk_size / 2, 1);
+        } else {
+            candidates.resize(candidates.size() - n);
+            for (Glucose::Lit lit : chunk) {
+                backbone.push_back(lit);
+                solver.addClause(lit);
+                if (observer != nullptr) {
+                    observer->OnProven(lit);
+                }
+            }
+            chunk_size = std::min(chunk_size * 2, kMaxChunkSize);
+        }
+    }
+
+    if (complete != nullptr) {
+        *complete = true;
+    }
+    return backbone;
+}
+
+std::vector<Glucose::Lit> ComputeBackboneParallel(Glucose::Solver& solver, const std::vector<Glucose::Var>& vars,
+                                                  const std::function<void(Glucose::Solver&)>& build_solver,
+                                                  int num_threads, bool* complete, BackboneObserver* observer) {
+#ifdef __EMSCRIPTEN__
+    return ComputeBackbone(solver, vars, complete, observer);
+#else
+    if (num_threads <= 1) {
+        return ComputeBackbone(solver, vars, complete, observer);
+    }
+
+    ParallelBackbone backbone(InitialCandidates(solver, vars), num_threads, observer);
+    std::vector<std::thread> threads;
+    for (int w = 1; w < num_threads; ++w) {
+        threads.emplace_back([&, w]() {
+            Glucose::Solver worker_solver;
+            build_solver(worker_solver);
+            backbone.Run(worker_solver, w);
+        });
+    }
+    backbone.Run(solver, 0);
+    for (auto& th : threads) {
+        th.join();
+    }
+
+    std::vector<Glucose::Lit> ret = backbone.backbone();
+    for (Glucose::Lit lit : ret) {
+        solver.addClause(lit);
+    }
+    if (complete != nullptr) {
+        *complete = !backbone.stopped();
+    }
+    return ret;
+#endif
+}
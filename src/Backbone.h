@@ -0,0 +1,55 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "core/Solver.h"
+
+// Receives the progress of a backbone computation. The functions are called on the threads of the workers, but never
+// concurrently.
+class BackboneObserver {
+public:
+    virtual ~BackboneObserver() = default;
+
+    // `num_candidates` literals are neither proven nor refuted yet, and `num_proven` literals are proven to be in the
+    // backbone
+    virtual void OnProgress(int num_candidates, int num_proven) {}
+
+    // Called as soon as the candidate `lit` is proven to be in the backbone, or refuted by a model in which it is
+    // false. Each candidate is either proven or refuted at most once.
+    virtual void OnProven(Glucose::Lit lit) {}
+    virtual void OnRefuted(Glucose::Lit lit) {}
+};
+
+// Computes the backbone over `vars`, that is, the literals of these variables which are true in every model.
+// `solver` must have just found a model by `solve`.
+//
+// Candidates are the literals true in the current model. They are tested in chunks: an activation literal `a` and a
+// clause (~a | ~l_1 | ... | ~l_k) are added, and the solver is run assuming `a`. If it is unsatisfiable, all of
+// l_1, ..., l_k are in the backbone; otherwise the new model rules out every candidate it disagrees with. The chunk
+// grows while chunks are proven and shrinks when models are found.
+//
+// The clause is disabled by the unit clause ~a after use, and the backbone literals found are added as unit clauses.
+// Both are implied by the original clauses, so `solver` keeps the same set of models (over the original variables) and
+// can be used for further queries.
+//
+// The solver is run by `solveLimited`. If a run ends without an answer (because of an interrupt or a budget), the
+// computation stops there and only the literals proven so far are returned. `complete`, if not null, is set to whether
+// the returned literals are the whole backbone. `observer`, if not null, is notified of each candidate as soon as it is
+// proven or refuted.
+std::vector<Glucose::Lit> ComputeBackbone(Glucose::Solver& solver, const std::vector<Glucose::Var>& vars,
+                                          bool* complete = nullptr, BackboneObserver* observer = nullptr);
+
+// Parallel version of `ComputeBackbone` with `num_threads` workers, each of which has its own solver. `solver` is used
+// by one of the workers, and `build_solver` must set up a fresh solver for the same problem with the same variable
+// numbering for each of the others.
+//
+// Each worker owns a queue of candidates and steals from the other queues when its own is empty. A model found by a
+// worker rules out candidates for all workers, and backbone literals proven by a worker are added to the solvers of
+// the others as unit clauses. Without thread support (under Emscripten), or if `num_threads` is at most 1, this is the
+// same as `ComputeBackbone`. When a run of any worker ends without an answer, the other workers stop after their
+// current runs.
+std::vector<Glucose::Lit> ComputeBackboneParallel(Glucose::Solver& solver, const std::vector<Glucose::Var>& vars,
+                                                  const std::function<void(Glucose::Solver&)>& build_solver,
+                                                  int num_threads, bool* complete = nullptr,
+                                                  BackboneObserver* observer = nullptr);
@@ -0,0 +1,109 @@
+#include "Batch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::string FormatResult(int index, const std::string& url, const BatchResult& result, double time_ms) {
+    std::ostringstream oss;
+    oss << "{\"index\":" << index << ",\"url\":" << JsonString(url) << ",\"status\":" << JsonString(result.status);
+    if (!result.answer_json.empty()) {
+        oss << ",\"answer\":" << result.answer_json;
+    }
+    char time_str[32];
+    snprintf(time_str, sizeof(time_str), "%.3f", time_ms);
+    oss << ",\"time_ms\":" << time_str << ",\"conflicts\":" << result.conflicts << "}";
+    return oss.str();
+}
+
+}
+
+void RunBatch(std::istream& in, std::ostream& out, int num_threads,
+              const std::function<BatchResult(const std::string& url)>& solve) {
+    std::vector<std::string> urls;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (!line.empty()) {
+            urls.push_back(line);
+        }
+    }
+
+    std::atomic<int> next_index(0);
+    std::mutex output_mutex;
+    std::vector<std::optional<std::string>> lines(urls.size());
+    int num_written = 0;
+
+    auto worker = [&]() {
+        for (;;) {
+            int i = next_index.fetch_add(1);
+            if (i >= (int)urls.size()) {
+                break;
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            BatchResult result = solve(urls[i]);
+            auto end = std::chrono::steady_clock::now();
+            double time_ms = std::chrono::duration<double, std::milli>(end - start).count();
+            std::string formatted = FormatResult(i, urls[i], result, time_ms);
+
+            std::lock_guard<std::mutex> lock(output_mutex);
+            lines[i] = std::move(formatted);
+            for (; num_written < (int)urls.size() && lines[num_written].has_value(); ++num_written) {
+                out << *lines[num_written] << '\n';
+                lines[num_written].reset();
+            }
+            out.flush();
+        }
+    };
+
+    num_threads = std::max(std::min<int>(num_threads, urls.size()), 1);
+    std::vector<std::thread> threads;
+    for (int t = 1; t < num_threads; ++t) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& th : threads) {
+        th.join();
+    }
+}
+
+std::string JsonString(const std::string& s) {
+    std::string ret = "\"";
+    for (char c : s) {
+        switch (c) {
+        case '"':
+            ret += "\\\"";
+            break;
+        case '\\':
+            ret += "\\\\";
+            break;
+        case '\n':
+            ret += "\\n";
+            break;
+        case '\t':
+            ret += "\\t";
+            break;
+        default:
+            if ((unsigned char)c < 0x20) {
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\u%04x", c);
+                ret += buf;
+            } else {
+                ret += c;
+            }
+        }
+    }
+    ret += "\"";
+    return ret;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <string>
+
+// Result of solving one puzzle in batch mode
+struct BatchResult {
+    // Short keyword such as "solved", "no_answer" or "invalid_url"
+    std::string status;
+
+    // JSON value of the answer, or empty if there is no answer
+    std::string answer_json;
+
+    uint64_t conflicts = 0;
+};
+
+// Reads puzzle URLs from `in` (one per line, empty lines are skipped), solves them by `solve` on `num_threads` threads
+// and writes one JSON object per line to `out`:
+//
+//   {"index":<0-based index among the URLs>,"url":...,"status":...,"answer":...,"time_ms":...,"conflicts":...}
+//
+// where "answer" is omitted if `answer_json` is empty. Lines are written in the input order, each as soon as all the
+// preceding ones are written. `solve` is called concurrently from multiple threads.
+void RunBatch(std::istream& in, std::ostream& out, int num_threads,
+              const std::function<BatchResult(const std::string& url)>& solve);
+
+// Returns `s` as a JSON string literal
+std::string JsonString(const std::string& s);
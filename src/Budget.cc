@@ -0,0 +1,28 @@
+#include "Budget.h"
+
+BudgetTracker::BudgetTracker(const SolveBudget& budget) : budget_(budget) {
+    if (budget_.time_limit_ms >= 0) {
+        deadline_ = std::chrono::steady_clock::now() + std::chrono::milliseconds(budget_.time_limit_ms);
+    }
+}
+
+bool BudgetTracker::IsLimited() const {
+    return budget_.time_limit_ms >= 0 || budget_.conflict_limit >= 0 || budget_.propagation_limit >= 0 ||
+           budget_.cancellation != nullptr;
+}
+
+bool BudgetTracker::IsExceeded(const Glucose::Solver& solver) const {
+    if (budget_.conflict_limit >= 0 && solver.conflicts >= (uint64_t)budget_.conflict_limit) {
+        return true;
+    }
+    if (budget_.propagation_limit >= 0 && solver.propagations >= (uint64_t)budget_.propagation_limit) {
+        return true;
+    }
+    if (budget_.cancellation != nullptr && budget_.cancellation->IsCancelled()) {
+        return true;
+    }
+    if (budget_.time_limit_ms >= 0 && std::chrono::steady_clock::now() >= deadline_) {
+        return true;
+    }
+    return false;
+}
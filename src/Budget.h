@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "core/Solver.h"
+
+// Flag for cancelling solver calls from another thread
+class CancellationToken {
+public:
+    CancellationToken() = default;
+    // A token which is also cancelled when `parent` (if not null) is. `parent` must outlive this.
+    explicit CancellationToken(const CancellationToken* parent) : parent_(parent) {}
+
+    void Cancel() { cancelled_.store(true, std::memory_order_relaxed); }
+    bool IsCancelled() const {
+        return cancelled_.load(std::memory_order_relaxed) || (parent_ != nullptr && parent_->IsCancelled());
+    }
+
+private:
+    std::atomic<bool> cancelled_{false};
+    const CancellationToken* parent_ = nullptr;
+};
+
+// Limits of a solver call. Negative values mean no limit.
+struct SolveBudget {
+    // Wall-clock limit of the whole call in milliseconds
+    int64_t time_limit_ms = -1;
+
+    // Limits of the number of conflicts and propagated literals. They apply to each SAT solver separately (a call may
+    // run several solvers on their own threads), counted from its creation.
+    int64_t conflict_limit = -1;
+    int64_t propagation_limit = -1;
+
+    // If not null, the call stops soon after this is cancelled
+    const CancellationToken* cancellation = nullptr;
+};
+
+// `SolveBudget` of an ongoing call, whose deadline is fixed on construction. This is shared by all solvers of the call.
+class BudgetTracker {
+public:
+    explicit BudgetTracker(const SolveBudget& budget);
+
+    // Whether there is any limit at all
+    bool IsLimited() const;
+
+    // Whether `solver` should stop: the deadline has passed, the call is cancelled, or `solver` has exceeded its
+    // conflict or propagation limit. Once this returns true, it keeps returning true for the same solver.
+    bool IsExceeded(const Glucose::Solver& solver) const;
+
+private:
+    SolveBudget budget_;
+    std::chrono::steady_clock::time_point deadline_;
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+
+#include "Grid.h"
+
+// Connected component labeling on grid graphs, shared by all genres.
+//
+// `Policy` must provide the following member functions:
+//   bool Contains(int y, int x) const;
+//       Whether cell (y, x) is a vertex of the graph. Cells which are not vertices are labeled -1.
+//   bool Passable(int y, int x, int y2, int x2) const;
+//       Whether two orthogonally adjacent vertices (y, x) and (y2, x2) are connected.
+//
+// The search uses an explicit stack instead of recursion, so its depth is not limited by the call stack (which matters
+// on large boards and in the WASM build). `stack` is a work area which can be reused across calls.
+
+// Labels all cells reachable from (y, x) with `id`. (y, x) must be a vertex not labeled yet.
+// Returns the number of labeled cells.
+template <typename Policy>
+int FloodConnectedComponent(const Policy& policy, Grid<int>& group_id, int y, int x, int id,
+                            std::vector<std::pair<int, int>>& stack) {
+    int height = group_id.height();
+    int width = group_id.width();
+    int size = 1;
+
+    stack.clear();
+    group_id.at(y, x) = id;
+    stack.push_back({y, x});
+
+    auto visit = [&](int y1, int x1, int y2, int x2) {
+        if (group_id.at(y2, x2) == -1 && policy.Contains(y2, x2) && policy.Passable(y1, x1, y2, x2)) {
+            group_id.at(y2, x2) = id;
+            stack.push_back({y2, x2});
+            ++size;
+        }
+    };
+
+    while (!stack.empty()) {
+        auto [y1, x1] = stack.back();
+        stack.pop_back();
+
+        if (y1 > 0) {
+            visit(y1, x1, y1 - 1, x1);
+        }
+        if (y1 < height - 1) {
+            visit(y1, x1, y1 + 1, x1);
+        }
+        if (x1 > 0) {
+            visit(y1, x1, y1, x1 - 1);
+        }
+        if (x1 < width - 1) {
+            visit(y1, x1, y1, x1 + 1);
+        }
+    }
+
+    return size;
+}
+
+// Labels all connected components with ids from 0, in the row-major order of their first cells.
+// All cells of `group_id` are overwritten. Returns the number of components.
+template <typename Policy>
+int LabelConnectedComponents(const Policy& policy, Grid<int>& group_id, std::vector<std::pair<int, int>>& stack) {
+    group_id.fill(-1);
+
+    int id_last = 0;
+    for (int y = 0; y < group_id.height(); ++y) {
+        for (int x = 0; x < group_id.width(); ++x) {
+            if (group_id.at(y, x) == -1 && policy.Contains(y, x)) {
+                FloodConnectedComponent(policy, group_id, y, x, id_last++, stack);
+            }
+        }
+    }
+    return id_last;
+}
@@ -0,0 +1,180 @@
+#include "CubeAndConquer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+
+#ifndef __EMSCRIPTEN__
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#endif
+
+namespace {
+
+#ifndef __EMSCRIPTEN__
+
+struct Cube {
+    std::vector<Glucose::Lit> assumptions;
+    int64_t conflict_budget; // -1 for no limit
+};
+
+class CubeQueue {
+public:
+    CubeQueue(const std::vector<Glucose::Solver*>& solvers, const std::vector<Glucose::Var>& split_vars)
+        : solvers_(solvers), split_vars_(split_vars), num_running_(0), winner_(-1), aborted_(false) {}
+
+    void Push(Cube cube) { queue_.push_back(std::move(cube)); }
+    void Run(int worker);
+    int winner() const { return winner_; }
+    bool aborted() const { return aborted_; }
+
+private:
+    // Returns the first split variable not in `cube`, or -1 if there is no such variable.
+    Glucose::Var NextSplitVar(const Cube& cube) const;
+
+    const std::vector<Glucose::Solver*>& solvers_;
+    const std::vector<Glucose::Var>& split_vars_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Cube> queue_;
+    int num_running_;
+    int winner_;
+    bool aborted_; // a cube is stopped before its conflict budget is exhausted
+};
+
+Glucose::Var CubeQueue::NextSplitVar(const Cube& cube) const {
+    for (Glucose::Var v : split_vars_) {
+        bool used = false;
+        for (Glucose::Lit lit : cube.assumptions) {
+            if (Glucose::var(lit) == v) {
+                used = true;
+                break;
+            }
+        }
+        if (!used) {
+            return v;
+        }
+    }
+    return -1;
+}
+
+void CubeQueue::Run(int worker) {
+    Glucose::Solver& solver = *solvers_[worker];
+    for (;;) {
+        Cube cube;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [&]() { return winner_ != -1 || aborted_ || !queue_.empty() || num_running_ == 0; });
+            if (winner_ != -1 || aborted_ || queue_.empty()) {
+                // A model is found, the search is aborted, or all cubes are refuted
+                return;
+            }
+            // Deeper cubes are at the back; taking them first keeps the queue short
+            cube = std::move(queue_.back());
+            queue_.pop_back();
+            ++num_running_;
+        }
+
+        Glucose::vec<Glucose::Lit> assumptions;
+        for (Glucose::Lit lit : cube.assumptions) {
+            assumptions.push(lit);
+        }
+        if (cube.conflict_budget >= 0) {
+            solver.setConfBudget(cube.conflict_budget);
+        } else {
+            solver.budgetOff();
+        }
+        uint64_t conflicts_before = solver.conflicts;
+        Glucose::lbool res = solver.solveLimited(assumptions);
+        solver.budgetOff();
+        bool budget_exhausted =
+            cube.conflict_budget >= 0 && solver.conflicts - conflicts_before >= (uint64_t)cube.conflict_budget;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        --num_running_;
+        if (res == l_True) {
+            if (winner_ == -1) {
+                winner_ = worker;
+                for (int i = 0; i < (int)solvers_.size(); ++i) {
+                    if (i != worker) {
+                        solvers_[i]->interrupt();
+                    }
+                }
+            }
+        } else if (res == l_Undef && winner_ == -1 && !budget_exhausted) {
+            // Interrupted from elsewhere (e.g. by the budget of the whole call): give up
+            if (!aborted_) {
+                aborted_ = true;
+                for (int i = 0; i < (int)solvers_.size(); ++i) {
+                    if (i != worker) {
+                        solvers_[i]->interrupt();
+                    }
+                }
+            }
+        } else if (res == l_Undef && winner_ == -1) {
+            // Out of budget: split the cube
+            Glucose::Var v = NextSplitVar(cube);
+            if (v == -1) {
+                cube.conflict_budget = -1;
+                queue_.push_back(std::move(cube));
+            } else {
+                Cube other = cube;
+                cube.assumptions.push_back(Glucose::mkLit(v, false));
+                other.assumptions.push_back(Glucose::mkLit(v, true));
+                cube.conflict_budget *= 2;
+                other.conflict_budget *= 2;
+                queue_.push_back(std::move(cube));
+                queue_.push_back(std::move(other));
+            }
+        }
+        cv_.notify_all();
+    }
+}
+
+#endif
+
+} // namespace
+
+int SolveByCubes(const std::vector<Glucose::Solver*>& solvers, const std::vector<Glucose::Var>& split_vars,
+                 const CubeAndConquerOptions& options, Glucose::lbool& result) {
+    assert(!solvers.empty());
+#ifndef __EMSCRIPTEN__
+    if (solvers.size() >= 2) {
+        CubeQueue queue(solvers, split_vars);
+        int depth = std::min<int>(options.initial_depth, split_vars.size());
+        for (int bits = 0; bits < (1 << depth); ++bits) {
+            Cube cube;
+            for (int i = 0; i < depth; ++i) {
+                cube.assumptions.push_back(Glucose::mkLit(split_vars[i], ((bits >> i) & 1) != 0));
+            }
+            cube.conflict_budget = options.conflict_budget;
+            queue.Push(std::move(cube));
+        }
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < (int)solvers.size(); ++i) {
+            threads.emplace_back([&, i]() { queue.Run(i); });
+        }
+        for (auto& th : threads) {
+            th.join();
+        }
+        for (auto* solver : solvers) {
+            solver->clearInterrupt();
+        }
+
+        int winner = queue.winner();
+        if (winner == -1 && queue.aborted()) {
+            result = l_Undef;
+            return -1;
+        }
+        result = winner == -1 ? l_False : l_True;
+        return winner;
+    }
+#endif
+    Glucose::vec<Glucose::Lit> assumptions;
+    result = solvers[0]->solveLimited(assumptions);
+    return result == l_True ? 0 : -1;
+}
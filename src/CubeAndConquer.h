@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "core/Solver.h"
+
+struct CubeAndConquerOptions {
+    // Cubes are initially all the combinations of the first `initial_depth` split variables
+    int initial_depth = 4;
+
+    // Number of conflicts a cube may take before it is split into two by the next split variable. The budget is
+    // doubled on every split, so that deeper cubes, which are expected to be easier, are not split too eagerly.
+    int64_t conflict_budget = 10000;
+};
+
+// Solves a problem by cube-and-conquer. `solvers` are set up for the same problem with the same variable numbering,
+// and each of them is run by its own worker thread. Cubes (sets of assumptions over `split_vars`, which are chosen in
+// the given order) are taken from a shared queue; a cube which exhausts its conflict budget is split again and put
+// back to the queue.
+//
+// Returns the index of the solver which found a model if `result` is l_True. If `result` is l_False, every cube is
+// unsatisfiable and the return value is -1. If a solver is interrupted from elsewhere (e.g. because of a budget), the
+// search is given up: `result` is l_Undef and the return value is -1. The solvers can be used again afterwards. Without
+// thread support (under Emscripten), `solvers[0]` just solves the whole problem.
+int SolveByCubes(const std::vector<Glucose::Solver*>& solvers, const std::vector<Glucose::Var>& split_vars,
+                 const CubeAndConquerOptions& options, Glucose::lbool& result);
@@ -0,0 +1,308 @@
+#include "Description.h"
+
+#include <cstdlib>
+#include <sstream>
+
+#include "doublechoco/Problem.h"
+#include "doublechoco/SolveCache.h"
+#include "doublechoco/Solver.h"
+#include "evolmino/Problem.h"
+#include "evolmino/SolveCache.h"
+#include "evolmino/Solver.h"
+
+std::string DescribeDoublechocoAnswer(const doublechoco::Problem& problem, const doublechoco::DoublechocoAnswer& ans) {
+    using namespace doublechoco;
+
+    int height = problem.height();
+    int width = problem.width();
+
+    std::ostringstream oss;
+    oss << "{\"kind\":\"grid\",\"height\":" << height << ",\"width\":" << width
+        << ",\"defaultStyle\":\"outer_grid\",\"data\":[";
+    bool is_first = true;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            if (problem.color(y, x) == 1) {
+                if (!is_first) {
+                    oss << ",";
+                } else {
+                    is_first = false;
+                }
+                oss << "{\"y\":" << y * 2 + 1 << ",\"x\":" << x * 2 + 1 << ",\"color\":\"#eeeeee\",\"item\":\"fill\"}";
+            }
+            if (problem.num(y, x) > 0) {
+                if (!is_first) {
+                    oss << ",";
+                } else {
+                    is_first = false;
+                }
+                int n = problem.num(y, x);
+                oss << "{\"y\":" << y * 2 + 1 << ",\"x\":" << x * 2 + 1 << ",\"color\":\"black\","
+                    << "\"item\":{\"kind\":\"text\",\"data\":\"" << n << "\"}}";
+            }
+        }
+    }
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            if (y < height - 1) {
+                if (ans.vertical[y][x] != DoublechocoAnswer::Border::kWall) {
+                    oss << ",{\"y\":" << y * 2 + 2 << ",\"x\":" << x * 2 + 1
+                        << ",\"color\":\"#cccccc\",\"item\":\"wall\"}";
+                }
+                if (ans.vertical[y][x] != DoublechocoAnswer::Border::kUndecided) {
+                    const char* kind = ans.vertical[y][x] == DoublechocoAnswer::Border::kWall ? "boldWall" : "cross";
+                    oss << ",{\"y\":" << y * 2 + 2 << ",\"x\":" << x * 2 + 1 << ",\"color\":\"green\",\"item\":\""
+                        << kind << "\"}";
+                }
+            }
+            if (x < width - 1) {
+                if (ans.horizontal[y][x] != DoublechocoAnswer::Border::kWall) {
+                    oss << ",{\"y\":" << y * 2 + 1 << ",\"x\":" << x * 2 + 2
+                        << ",\"color\":\"#cccccc\",\"item\":\"wall\"}";
+                }
+                if (ans.horizontal[y][x] != DoublechocoAnswer::Border::kUndecided) {
+                    const char* kind = ans.horizontal[y][x] == DoublechocoAnswer::Border::kWall ? "boldWall" : "cross";
+                    oss << ",{\"y\":" << y * 2 + 1 << ",\"x\":" << x * 2 + 2 << ",\"color\":\"green\",\"item\":\""
+                        << kind << "\"}";
+                }
+            }
+        }
+    }
+    oss << "]}";
+
+    return oss.str();
+}
+
+std::string DescribeEvolminoAnswer(const evolmino::Problem& problem, const evolmino::EvolminoAnswer& ans) {
+    using namespace evolmino;
+
+    int height = problem.height();
+    int width = problem.width();
+
+    std::ostringstream oss;
+    oss << "{\"kind\":\"grid\",\"height\":" << height << ",\"width\":" << width
+        << ",\"defaultStyle\":\"grid\",\"data\":[";
+    bool is_first = true;
+    for (int i = 0; i < problem.NumArrows(); ++i) {
+        const auto& arrow = problem.GetArrow(i);
+        for (int j = 1; j < arrow.size(); ++j) {
+            if (!is_first) {
+                oss << ",";
+            } else {
+                is_first = false;
+            }
+            int y = arrow[j - 1].first + arrow[j].first + 1;
+            int x = arrow[j - 1].second + arrow[j].second + 1;
+            oss << "{\"y\":" << y << ",\"x\":" << x << ",\"color\":\"black\",\"item\":\"line\"}";
+        }
+    }
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            switch (problem.cell(y, x)) {
+                case Problem::Cell::kEmpty:
+                    break;
+                case Problem::Cell::kBlack:
+                    if (!is_first) {
+                        oss << ",";
+                    } else {
+                        is_first = false;
+                    }
+                    oss << "{\"y\":" << y * 2 + 1 << ",\"x\":" << x * 2 + 1 << ",\"color\":\"black\",\"item\":\"fill\"}";
+                    continue;
+                case Problem::Cell::kSquare:
+                    if (!is_first) {
+                        oss << ",";
+                    } else {
+                        is_first = false;
+                    }
+                    oss << "{\"y\":" << y * 2 + 1 << ",\"x\":" << x * 2 + 1 << ",\"color\":\"black\",\"item\":\"square\"}";
+                    continue;
+            }
+
+            if (ans.at(y, x) == EvolminoAnswerCell::kSquare) {
+                if (!is_first) {
+                    oss << ",";
+                } else {
+                    is_first = false;
+                }
+                oss << "{\"y\":" << y * 2 + 1 << ",\"x\":" << x * 2 + 1 << ",\"color\":\"green\",\"item\":\"square\"}";
+            } else if (ans.at(y, x) == EvolminoAnswerCell::kEmpty) {
+                if (!is_first) {
+                    oss << ",";
+                } else {
+                    is_first = false;
+                }
+                oss << "{\"y\":" << y * 2 + 1 << ",\"x\":" << x * 2 + 1 << ",\"color\":\"green\",\"item\":\"dot\"}";
+            }
+        }
+    }
+
+    oss << "]}";
+
+    return oss.str();
+}
+
+namespace {
+
+// `description` is the description of the answer, if any. Both genres share `SolveResult::Status` values.
+template <typename Status>
+std::string DescribeSolveResult(Status status, const std::string& description) {
+    if (status == Status::kNoAnswer) {
+        return "{\"description\":\"no answer\"}";
+    }
+    if (status == Status::kUnknown) {
+        return "{\"description\":" + (description.empty() ? "\"timeout\"" : description) + ",\"timeout\":true}";
+    }
+    return "{\"description\":" + description + "}";
+}
+
+// JSON of a deduction for `SolveToDescriptionStreaming`
+std::string DescribeDeduction(int y, int x, const char* value) {
+    return "{\"y\":" + std::to_string(y) + ",\"x\":" + std::to_string(x) + ",\"value\":\"" + value + "\"}";
+}
+
+std::string SolveDoublechoco(const std::string& url, const SolveBudget& budget, ResultCache* cache,
+                             const std::function<void(const std::string&)>& on_deduction) {
+    using namespace doublechoco;
+
+    std::optional<Problem> problem_opt = Problem::ParseURL(url);
+    if (!problem_opt) {
+        return "{\"description\":\"invalid url\"}";
+    }
+    Problem problem = *problem_opt;
+
+    SolverOptions options;
+    if (on_deduction) {
+        options.on_border = [&](const BorderDeduction& deduction) {
+            int y = deduction.is_horizontal ? deduction.y * 2 + 1 : deduction.y * 2 + 2;
+            int x = deduction.is_horizontal ? deduction.x * 2 + 2 : deduction.x * 2 + 1;
+            const char* value = deduction.border == DoublechocoAnswer::Border::kWall        ? "wall"
+                                : deduction.border == DoublechocoAnswer::Border::kConnected ? "connected"
+                                                                                            : "free";
+            on_deduction(DescribeDeduction(y, x, value));
+        };
+    }
+    SolveResult res = cache != nullptr ? SolveCached(problem, *cache, budget, options)
+                                       : SolveLimited(problem, budget, options);
+    return DescribeSolveResult(res.status, res.answer ? DescribeDoublechocoAnswer(problem, *res.answer) : "");
+}
+
+std::string CheckUniquenessDoublechoco(const std::string& url) {
+    using namespace doublechoco;
+
+    std::optional<Problem> problem_opt = Problem::ParseURL(url);
+    if (!problem_opt) {
+        return "{\"description\":\"invalid url\"}";
+    }
+    Problem problem = *problem_opt;
+
+    UniquenessResult res = CheckUniqueness(problem);
+    switch (res.status) {
+    case UniquenessResult::kNoAnswer:
+        return "{\"uniqueness\":\"none\",\"description\":\"no answer\"}";
+    case UniquenessResult::kUnique:
+        return "{\"uniqueness\":\"unique\",\"description\":" + DescribeDoublechocoAnswer(problem, *res.first) + "}";
+    case UniquenessResult::kMultiple:
+        return "{\"uniqueness\":\"multiple\",\"description\":" + DescribeDoublechocoAnswer(problem, *res.first) +
+               ",\"another\":" + DescribeDoublechocoAnswer(problem, *res.second) + "}";
+    case UniquenessResult::kUnknown:
+        // `CheckUniqueness` has no budget
+        break;
+    }
+    abort();
+}
+
+std::string SolveEvolmino(const std::string& url, const SolveBudget& budget, ResultCache* cache,
+                          const std::function<void(const std::string&)>& on_deduction) {
+    using namespace evolmino;
+
+    std::optional<Problem> problem_opt = Problem::ParseURL(url);
+    if (!problem_opt) {
+        return "{\"description\":\"invalid url\"}";
+    }
+    Problem problem = *problem_opt;
+
+    SolverOptions options;
+    if (on_deduction) {
+        options.on_cell = [&](const CellDeduction& deduction) {
+            const char* value = deduction.cell == EvolminoAnswerCell::kSquare  ? "square"
+                                : deduction.cell == EvolminoAnswerCell::kEmpty ? "empty"
+                                                                               : "free";
+            on_deduction(DescribeDeduction(deduction.y * 2 + 1, deduction.x * 2 + 1, value));
+        };
+    }
+    SolveResult res = cache != nullptr ? SolveCached(problem, *cache, budget, options)
+                                       : SolveLimited(problem, budget, options);
+    return DescribeSolveResult(res.status, res.answer ? DescribeEvolminoAnswer(problem, *res.answer) : "");
+}
+
+std::string CheckUniquenessEvolmino(const std::string& url) {
+    using namespace evolmino;
+
+    std::optional<Problem> problem_opt = Problem::ParseURL(url);
+    if (!problem_opt) {
+        return "{\"description\":\"invalid url\"}";
+    }
+    Problem problem = *problem_opt;
+
+    UniquenessResult res = CheckUniqueness(problem);
+    switch (res.status) {
+        case UniquenessResult::kNoAnswer:
+            return "{\"uniqueness\":\"none\",\"description\":\"no answer\"}";
+        case UniquenessResult::kUnique:
+            return "{\"uniqueness\":\"unique\",\"description\":" + DescribeEvolminoAnswer(problem, *res.first) + "}";
+        case UniquenessResult::kMultiple:
+            return "{\"uniqueness\":\"multiple\",\"description\":" + DescribeEvolminoAnswer(problem, *res.first) +
+                   ",\"another\":" + DescribeEvolminoAnswer(problem, *res.second) + "}";
+        case UniquenessResult::kUnknown:
+            // `CheckUniqueness` has no budget
+            break;
+    }
+    abort();
+}
+
+} // namespace
+
+std::string SolveToDescription(const std::string& url, const SolveBudget& budget, ResultCache* cache) {
+    std::string dbchoco_prefix("https://puzz.link/p?dbchoco/");
+    if (url.size() >= dbchoco_prefix.size() && url.substr(0, dbchoco_prefix.size()) == dbchoco_prefix) {
+        return SolveDoublechoco(url, budget, cache, nullptr);
+    }
+
+    std::string evolmino_prefix("https://puzz.link/p?evolmino/");
+    if (url.size() >= evolmino_prefix.size() && url.substr(0, evolmino_prefix.size()) == evolmino_prefix) {
+        return SolveEvolmino(url, budget, cache, nullptr);
+    }
+
+    return "{\"description\":\"invalid url\"}";
+}
+
+std::string SolveToDescriptionStreaming(const std::string& url,
+                                        const std::function<void(const std::string&)>& on_deduction,
+                                        const SolveBudget& budget) {
+    std::string dbchoco_prefix("https://puzz.link/p?dbchoco/");
+    if (url.size() >= dbchoco_prefix.size() && url.substr(0, dbchoco_prefix.size()) == dbchoco_prefix) {
+        return SolveDoublechoco(url, budget, nullptr, on_deduction);
+    }
+
+    std::string evolmino_prefix("https://puzz.link/p?evolmino/");
+    if (url.size() >= evolmino_prefix.size() && url.substr(0, evolmino_prefix.size()) == evolmino_prefix) {
+        return SolveEvolmino(url, budget, nullptr, on_deduction);
+    }
+
+    return "{\"description\":\"invalid url\"}";
+}
+
+std::string CheckUniquenessToDescription(const std::string& url) {
+    std::string dbchoco_prefix("https://puzz.link/p?dbchoco/");
+    if (url.size() >= dbchoco_prefix.size() && url.substr(0, dbchoco_prefix.size()) == dbchoco_prefix) {
+        return CheckUniquenessDoublechoco(url);
+    }
+
+    std::string evolmino_prefix("https://puzz.link/p?evolmino/");
+    if (url.size() >= evolmino_prefix.size() && url.substr(0, evolmino_prefix.size()) == evolmino_prefix) {
+        return CheckUniquenessEvolmino(url);
+    }
+
+    return "{\"description\":\"invalid url\"}";
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <functional>
+#include <string>
+
+#include "Budget.h"
+#include "ResultCache.h"
+#include "doublechoco/Problem.h"
+#include "doublechoco/Solver.h"
+#include "evolmino/Problem.h"
+#include "evolmino/Solver.h"
+
+// JSON descriptions of answers for the puzzle renderer, as grids with the clues and the decided borders / cells
+std::string DescribeDoublechocoAnswer(const doublechoco::Problem& problem, const doublechoco::DoublechocoAnswer& ans);
+std::string DescribeEvolminoAnswer(const evolmino::Problem& problem, const evolmino::EvolminoAnswer& ans);
+
+// Solves the puzzle of `url` (of any supported genre) and returns {"description": ...}, where the description is a grid
+// or an error message. If `budget` is exceeded, "timeout": true is added, and the description is the partial answer
+// (or "timeout" if there is none). If `cache` is not null, results of the same puzzle up to rotations and reflections
+// are reused from and stored to it.
+std::string SolveToDescription(const std::string& url, const SolveBudget& budget = SolveBudget(),
+                               ResultCache* cache = nullptr);
+
+// Same as `SolveToDescription` without a cache, but also calls `on_deduction` as soon as each border or cell is proven
+// with {"y": ..., "x": ..., "value": ...} in the coordinates of the description, where the value is "wall" /
+// "connected" for borders, "square" / "empty" for cells, or "free" if answers differ on it.
+std::string SolveToDescriptionStreaming(const std::string& url,
+                                        const std::function<void(const std::string&)>& on_deduction,
+                                        const SolveBudget& budget = SolveBudget());
+
+// Returns {"uniqueness": "none" | "unique" | "multiple", "description": ...}, with the second answer in "another" if
+// the answer is not unique
+std::string CheckUniquenessToDescription(const std::string& url);
@@ -0,0 +1,133 @@
+#include "core/Solver.h"
+
+#include "doublechoco/Balancer.h"
+#include "doublechoco/BoardManager.h"
+#include "doublechoco/Problem.h"
+#include "doublechoco/Propagator.h"
+#include "doublechoco/Solver.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace doublechoco;
+
+namespace {
+
+std::atomic<bool> counting(false);
+std::atomic<uint64_t> num_allocations(0);
+
+} // namespace
+
+// Glucose allocates its own data with malloc / realloc, so allocations counted here are those of C++ code running
+// during `solve`, that is, of the constraints.
+void* operator new(std::size_t size) {
+    if (counting.load(std::memory_order_relaxed)) {
+        num_allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    void* ptr = std::malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+
+// Checks that the constraints do not allocate on their hot paths (including conflicts and implications) while the
+// search is in a steady state. The constraints are the same as in `Solve` with the default `SolverOptions`.
+// For each puzzle, the first answer is found without counting, so that the work areas have grown to their final size.
+// Then, up to `number of answers` more answers are enumerated (by blocking each answer found) with counting enabled.
+// Exits with status 1 if any allocation is counted.
+// Usage: doublechoco-allocbench [file of puzzle URLs, one per line (default: stdin)] [number of answers (default: 20)]
+int main(int argc, char** argv) {
+    std::vector<std::string> urls;
+    {
+        std::ifstream file;
+        if (argc >= 2) {
+            file.open(argv[1]);
+            if (!file) {
+                printf("Error: cannot open %s\n", argv[1]);
+                return 1;
+            }
+        }
+        std::istream& in = argc >= 2 ? file : std::cin;
+        std::string line;
+        while (std::getline(in, line)) {
+            if (!line.empty()) {
+                urls.push_back(line);
+            }
+        }
+    }
+    int num_answers = argc >= 3 ? std::stoi(argv[2]) : 20;
+    SolverOptions options;
+
+    uint64_t total_allocations = 0, total_checks = 0;
+    for (auto& url : urls) {
+        std::optional<Problem> problem = Problem::ParseURL(url);
+        if (!problem) {
+            printf("Error: invalid url: %s\n", url.c_str());
+            continue;
+        }
+
+        Glucose::Solver solver;
+        Glucose::Var origin = BoardManager::AllocateVariables(solver, problem->height(), problem->width());
+        int num_vars = problem->height() * (problem->width() - 1) + (problem->height() - 1) * problem->width();
+        auto propagator_owned = std::make_unique<Propagator>(*problem, origin);
+        Propagator* propagator = propagator_owned.get();
+        solver.addConstraint(std::move(propagator_owned));
+        if (options.use_balancer) {
+            solver.addConstraint(std::make_unique<Balancer>(*problem, origin));
+        }
+
+        // Forbids the current model so that the next `solve` searches for another answer
+        auto block_model = [&]() {
+            Glucose::vec<Glucose::Lit> clause;
+            for (int i = 0; i < num_vars; ++i) {
+                clause.push(Glucose::mkLit(origin + i, solver.modelValue(origin + i) == l_True));
+            }
+            return solver.addClause(clause);
+        };
+
+        if (!solver.solve() || !block_model()) {
+            printf("%10s %10s %s\n", "-", "-", url.c_str());
+            continue;
+        }
+
+        const SimplePropagatorStats& stats = propagator->stats();
+        uint64_t checks_before = stats.cheap_runs + stats.expensive_runs;
+        num_allocations = 0;
+        counting = true;
+        for (int i = 0; i < num_answers; ++i) {
+            if (!solver.solve()) {
+                break;
+            }
+            counting = false;
+            bool ok = block_model();
+            counting = true;
+            if (!ok) {
+                break;
+            }
+        }
+        counting = false;
+
+        uint64_t checks = stats.cheap_runs + stats.expensive_runs - checks_before;
+        printf("%10llu %10llu %s\n", (unsigned long long)num_allocations.load(), (unsigned long long)checks,
+               url.c_str());
+        total_allocations += num_allocations;
+        total_checks += checks;
+    }
+
+    printf("total: %llu allocations in %llu propagator checks (%.4f per check)\n",
+           (unsigned long long)total_allocations, (unsigned long long)total_checks,
+           total_checks == 0 ? 0.0 : (double)total_allocations / total_checks);
+    return total_allocations == 0 ? 0 : 1;
+}
@@ -0,0 +1,101 @@
+#include "doublechoco/Problem.h"
+#include "doublechoco/Solver.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace doublechoco;
+
+// Compares the solver with and without `Balancer`, and reports the counters of the propagator tiers and the CDCL
+// search (including the average length of learnt clauses, which reflects the quality of the propagator reasons).
+// Usage: doublechoco-benchmark [--adaptive] [file of puzzle URLs, one per line (default: stdin)]
+//                              [number of repetitions]
+// With `--adaptive`, the shape finder is run with `ExpensiveTierSchedule::kAdaptive`.
+// benchmark/doublechoco.txt is a set of 52 random puzzles (6x6 to 12x12) for this purpose.
+int main(int argc, char** argv) {
+    ExpensiveTierSchedule schedule = ExpensiveTierSchedule::kAtFixpoint;
+    if (argc >= 2 && std::string(argv[1]) == "--adaptive") {
+        schedule = ExpensiveTierSchedule::kAdaptive;
+        --argc;
+        ++argv;
+    }
+
+    std::vector<std::string> urls;
+    {
+        std::ifstream file;
+        if (argc >= 2) {
+            file.open(argv[1]);
+            if (!file) {
+                printf("Error: cannot open %s\n", argv[1]);
+                return 1;
+            }
+        }
+        std::istream& in = argc >= 2 ? file : std::cin;
+        std::string line;
+        while (std::getline(in, line)) {
+            if (!line.empty()) {
+                urls.push_back(line);
+            }
+        }
+    }
+    int repetitions = argc >= 3 ? std::stoi(argv[2]) : 1;
+
+    double total_time[2] = {0.0, 0.0};
+    SimplePropagatorStats stats[2];
+    SearchStats search_stats[2];
+    bool mismatch = false;
+    for (auto& url : urls) {
+        std::optional<Problem> problem = Problem::ParseURL(url);
+        if (!problem) {
+            printf("Error: invalid url: %s\n", url.c_str());
+            continue;
+        }
+
+        double time[2];
+        std::optional<DoublechocoAnswer> answer[2];
+        for (int b = 0; b < 2; ++b) {
+            SolverOptions options;
+            options.use_balancer = b == 1;
+            options.shape_finder_schedule = schedule;
+            options.propagator_stats = &stats[b];
+            options.search_stats = &search_stats[b];
+
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < repetitions; ++i) {
+                answer[b] = Solve(*problem, options);
+            }
+            auto end = std::chrono::steady_clock::now();
+            time[b] = std::chrono::duration<double>(end - start).count() / repetitions;
+            total_time[b] += time[b];
+        }
+
+        bool same = answer[0].has_value() == answer[1].has_value() &&
+                    (!answer[0] || (answer[0]->horizontal == answer[1]->horizontal &&
+                                    answer[0]->vertical == answer[1]->vertical));
+        if (!same) {
+            mismatch = true;
+        }
+        printf("%10.4f %10.4f%s %s\n", time[0], time[1], same ? "" : " MISMATCH", url.c_str());
+    }
+
+    printf("total: %.4f (without balancer) / %.4f (with balancer)\n", total_time[0], total_time[1]);
+    for (int b = 0; b < 2; ++b) {
+        const SimplePropagatorStats& st = stats[b];
+        printf("%s balancer: cheap tier %llu runs, %llu conflicts, %llu implications / expensive tier %llu runs, "
+               "%llu conflicts, %llu implications, %llu skipped\n",
+               b == 0 ? "without" : "with", (unsigned long long)st.cheap_runs, (unsigned long long)st.cheap_conflicts,
+               (unsigned long long)st.cheap_implications, (unsigned long long)st.expensive_runs,
+               (unsigned long long)st.expensive_conflicts, (unsigned long long)st.expensive_implications,
+               (unsigned long long)st.expensive_skipped);
+        const SearchStats& ss = search_stats[b];
+        printf("%s balancer: %llu conflicts, %llu decisions, %llu propagations, average learnt clause length %.2f\n",
+               b == 0 ? "without" : "with", (unsigned long long)ss.conflicts, (unsigned long long)ss.decisions,
+               (unsigned long long)ss.propagations,
+               ss.conflicts == 0 ? 0.0 : (double)ss.learnt_literals / ss.conflicts);
+    }
+    return mismatch ? 1 : 0;
+}
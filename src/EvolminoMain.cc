@@ -1,28 +1,22 @@
 #include "evolmino/Problem.h"
+#include "evolmino/SolveCache.h"
 #include "evolmino/Solver.h"
 
-using namespace evolmino;
+#include "Batch.h"
+#include "ResultCache.h"
 
-int main(int argc, char** argv) {
-    std::optional<Problem> problem_opt = Problem::ParseURL(argv[1]);
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
 
-    if (!problem_opt) {
-        printf("Error: invalid url\n");
-        return 0;
-    }
-
-    Problem problem = *problem_opt;
-    int height = problem.height();
-    int width = problem.width();
-    std::optional<EvolminoAnswer> ans = Solve(problem);
-    if (!ans) {
-        puts("No answer");
-        return 0;
-    }
+using namespace evolmino;
 
-    for (int y = 0; y < height; ++y) {
-        for (int x = 0; x < width; ++x) {
-            switch (ans->at(y, x)) {
+void PrintAnswer(const EvolminoAnswer& ans) {
+    for (int y = 0; y < ans.height(); ++y) {
+        for (int x = 0; x < ans.width(); ++x) {
+            switch (ans.at(y, x)) {
                 case EvolminoAnswerCell::kSquare:
                     printf("# ");
                     break;
@@ -36,5 +30,195 @@ int main(int argc, char** argv) {
         }
         puts("");
     }
+}
+
+// Cells as one string per row: '#' for squares, 'x' for empty cells and '.' for undecided ones
+std::string AnswerToJson(const EvolminoAnswer& ans) {
+    std::string ret = "[";
+    for (int y = 0; y < ans.height(); ++y) {
+        if (y > 0) {
+            ret += ",";
+        }
+        ret += "\"";
+        for (int x = 0; x < ans.width(); ++x) {
+            switch (ans.at(y, x)) {
+                case EvolminoAnswerCell::kSquare:
+                    ret += '#';
+                    break;
+                case EvolminoAnswerCell::kEmpty:
+                    ret += 'x';
+                    break;
+                default:
+                    ret += '.';
+                    break;
+            }
+        }
+        ret += "\"";
+    }
+    return ret + "]";
+}
+
+// Results of puzzles solved before are taken from `cache` unless it is null
+BatchResult SolveForBatch(const std::string& url, const SolveBudget& budget, bool check_uniqueness,
+                          ResultCache* cache) {
+    BatchResult ret;
+    std::optional<Problem> problem = Problem::ParseURL(url);
+    if (!problem) {
+        ret.status = "invalid_url";
+        return ret;
+    }
+
+    SearchStats stats;
+    SolverOptions options;
+    options.search_stats = &stats;
+
+    if (check_uniqueness) {
+        UniquenessResult res = CheckUniquenessLimited(*problem, budget, options);
+        switch (res.status) {
+            case UniquenessResult::kNoAnswer:
+                ret.status = "no_answer";
+                break;
+            case UniquenessResult::kUnique:
+                ret.status = "unique";
+                break;
+            case UniquenessResult::kMultiple:
+                ret.status = "multiple";
+                break;
+            case UniquenessResult::kUnknown:
+                ret.status = "unknown";
+                break;
+        }
+        if (res.first) {
+            ret.answer_json = AnswerToJson(*res.first);
+        }
+    } else {
+        SolveResult res = cache != nullptr ? SolveCached(*problem, *cache, budget, options)
+                                           : SolveLimited(*problem, budget, options);
+        switch (res.status) {
+            case SolveResult::kSolved:
+                ret.status = "solved";
+                break;
+            case SolveResult::kNoAnswer:
+                ret.status = "no_answer";
+                break;
+            case SolveResult::kUnknown:
+                ret.status = "unknown";
+                break;
+        }
+        if (res.answer) {
+            ret.answer_json = AnswerToJson(*res.answer);
+        }
+    }
+    ret.conflicts = stats.conflicts;
+    return ret;
+}
+
+int main(int argc, char** argv) {
+    // Usage: evolmino-solver [--time-limit <ms>] [--conflict-limit <n>] [--check-uniqueness] <url>
+    //        evolmino-solver [options above] --batch [--jobs <n>] [--cache-size <n>] [--cache-file <path>]
+    //                        [file of URLs, one per line (default: stdin)]
+    // In batch mode, one JSON object per URL is written to stdout in the input order (see `RunBatch`). With a cache,
+    // puzzles equal up to rotations and reflections to those solved before (in this run, or in `--cache-file`) are not
+    // solved again.
+    // The limits apply to each puzzle, with or without `--check-uniqueness`.
+    bool check_uniqueness = false;
+    bool batch = false;
+    int num_jobs = 1;
+    size_t cache_size = 0;
+    const char* cache_file = nullptr;
+    SolveBudget budget;
+    const char* url = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--check-uniqueness") {
+            check_uniqueness = true;
+        } else if (std::string(argv[i]) == "--batch") {
+            batch = true;
+        } else if (std::string(argv[i]) == "--jobs" && i + 1 < argc) {
+            num_jobs = std::max(std::atoi(argv[++i]), 1);
+        } else if (std::string(argv[i]) == "--cache-size" && i + 1 < argc) {
+            cache_size = std::max(std::atoll(argv[++i]), 0LL);
+        } else if (std::string(argv[i]) == "--cache-file" && i + 1 < argc) {
+            cache_file = argv[++i];
+        } else if (std::string(argv[i]) == "--time-limit" && i + 1 < argc) {
+            budget.time_limit_ms = std::atoll(argv[++i]);
+        } else if (std::string(argv[i]) == "--conflict-limit" && i + 1 < argc) {
+            budget.conflict_limit = std::atoll(argv[++i]);
+        } else {
+            url = argv[i];
+        }
+    }
+    if (batch) {
+        std::ifstream file;
+        if (url != nullptr) {
+            file.open(url);
+            if (!file) {
+                printf("Error: cannot open %s\n", url);
+                return 1;
+            }
+        }
+        ResultCache cache_body(cache_size);
+        if (cache_file != nullptr && !cache_body.OpenStore(cache_file)) {
+            printf("Error: cannot open cache file %s\n", cache_file);
+            return 1;
+        }
+        ResultCache* cache = cache_size > 0 || cache_file != nullptr ? &cache_body : nullptr;
+        RunBatch(url != nullptr ? file : std::cin, std::cout, num_jobs,
+                 [&](const std::string& u) { return SolveForBatch(u, budget, check_uniqueness, cache); });
+        return 0;
+    }
+
+    if (url == nullptr) {
+        printf("Error: no url is given\n");
+        return 0;
+    }
+
+    std::optional<Problem> problem_opt = Problem::ParseURL(url);
+
+    if (!problem_opt) {
+        printf("Error: invalid url\n");
+        return 0;
+    }
+
+    Problem problem = *problem_opt;
+
+    if (check_uniqueness) {
+        UniquenessResult res = CheckUniquenessLimited(problem, budget);
+        switch (res.status) {
+            case UniquenessResult::kNoAnswer:
+                puts("No answer");
+                break;
+            case UniquenessResult::kUnknown:
+                puts("Unknown (the limit is exceeded)");
+                if (res.first) {
+                    PrintAnswer(*res.first);
+                }
+                break;
+            case UniquenessResult::kUnique:
+                puts("Unique");
+                PrintAnswer(*res.first);
+                break;
+            case UniquenessResult::kMultiple:
+                puts("Multiple answers");
+                PrintAnswer(*res.first);
+                puts("");
+                PrintAnswer(*res.second);
+                break;
+        }
+        return 0;
+    }
+
+    SolveResult res = SolveLimited(problem, budget);
+    if (res.status == SolveResult::kNoAnswer) {
+        puts("No answer");
+        return 0;
+    }
+    if (res.status == SolveResult::kUnknown) {
+        puts("Unknown (the limit is exceeded)");
+        if (!res.answer) {
+            return 0;
+        }
+    }
+
+    PrintAnswer(*res.answer);
     return 0;
 }
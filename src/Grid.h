@@ -16,9 +16,25 @@ public:
 
     ~Grid() { delete[] data_; }
 
+    Grid<T>& operator=(const Grid<T>& other) {
+        if (this == &other) {
+            return *this;
+        }
+        if (height_ * width_ != other.height_ * other.width_) {
+            delete[] data_;
+            data_ = new T[other.height_ * other.width_];
+        }
+        height_ = other.height_;
+        width_ = other.width_;
+        std::copy(other.data_, other.data_ + height_ * width_, data_);
+        return *this;
+    }
+
     int height() const { return height_; }
     int width() const { return width_; }
 
+    void fill(const T& value) { std::fill(data_, data_ + height_ * width_, value); }
+
     T& at(int y, int x) {
         assert(0 <= y && y < height_ && 0 <= x && x < width_);
         return data_[y * width_ + x];
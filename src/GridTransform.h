@@ -0,0 +1,34 @@
+#pragma once
+
+#include <utility>
+
+// One of the 8 symmetries (rotations and reflections) of a grid. A grid of `height` x `width` is mapped to a grid of
+// `transformed_height()` x `transformed_width()`.
+class GridTransform {
+public:
+    static constexpr int kNumTransforms = 8;
+
+    // The grid is transposed if bit 2 of `index` is set, and then flipped vertically / horizontally if bit 1 / bit 0 is
+    // set. Index 0 is the identity.
+    GridTransform(int height, int width, int index) : height_(height), width_(width), index_(index) {}
+
+    int transformed_height() const { return (index_ & 4) ? width_ : height_; }
+    int transformed_width() const { return (index_ & 4) ? height_ : width_; }
+
+    std::pair<int, int> Apply(int y, int x) const {
+        if (index_ & 4) {
+            std::swap(y, x);
+        }
+        if (index_ & 2) {
+            y = transformed_height() - 1 - y;
+        }
+        if (index_ & 1) {
+            x = transformed_width() - 1 - x;
+        }
+        return {y, x};
+    }
+
+private:
+    int height_, width_;
+    int index_;
+};
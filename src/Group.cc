@@ -1,6 +1,10 @@
 #include "Group.h"
 
-GroupInfo::GroupInfo(Grid<int>&& group_id) : group_id_(group_id) {
+GroupInfo::GroupInfo(Grid<int>&& group_id) : group_id_(group_id) { BuildGroups(); }
+
+GroupInfo::GroupInfo(int height, int width) : group_id_(height, width, -1) { BuildGroups(); }
+
+void GroupInfo::BuildGroups() {
     int max_group_id = 0;
     for (int y = 0; y < group_id_.height(); ++y) {
         for (int x = 0; x < group_id_.width(); ++x) {
@@ -8,7 +12,7 @@ GroupInfo::GroupInfo(Grid<int>&& group_id) : group_id_(group_id) {
         }
     }
 
-    groups_offset_ = std::vector<int>(max_group_id + 2, 0);
+    groups_offset_.assign(max_group_id + 2, 0);
     for (int y = 0; y < group_id_.height(); ++y) {
         for (int x = 0; x < group_id_.width(); ++x) {
             int id = group_id_.at(y, x);
@@ -20,13 +24,13 @@ GroupInfo::GroupInfo(Grid<int>&& group_id) : group_id_(group_id) {
     for (int i = 1; i < groups_offset_.size(); ++i) {
         groups_offset_[i] += groups_offset_[i - 1];
     }
-    std::vector<int> next_pos = groups_offset_;
-    groups_raw_ = std::vector<std::pair<int, int>>(group_id_.height() * group_id_.width());
+    next_pos_.assign(groups_offset_.begin(), groups_offset_.end());
+    groups_raw_.resize(group_id_.height() * group_id_.width());
     for (int y = 0; y < group_id_.height(); ++y) {
         for (int x = 0; x < group_id_.width(); ++x) {
             int id = group_id_.at(y, x);
             if (id >= 0) {
-                groups_raw_[next_pos[id]++] = std::make_pair(y, x);
+                groups_raw_[next_pos_[id]++] = std::make_pair(y, x);
             }
         }
     }
@@ -23,6 +23,20 @@ class GroupInfo {
 public:
     GroupInfo(Grid<int>&& group_id);
 
+    // Creates an instance without any group, which is to be filled by `Assign`
+    GroupInfo(int height, int width);
+
+    // Replaces the groups with those given by `group_id_of(y, x)` for each cell (-1 for cells in no group).
+    // The storage of this instance is reused, so no allocation happens once it is large enough.
+    template <typename F> void Assign(F group_id_of) {
+        for (int y = 0; y < group_id_.height(); ++y) {
+            for (int x = 0; x < group_id_.width(); ++x) {
+                group_id_.at(y, x) = group_id_of(y, x);
+            }
+        }
+        BuildGroups();
+    }
+
     int group_id(int y, int x) const { return group_id_.at(y, x); }
     int num_groups() const { return groups_offset_.size() - 1; }
     const Group<std::pair<int, int>> group(int id) const {
@@ -31,7 +45,10 @@ public:
     };
 
 private:
+    void BuildGroups();
+
     Grid<int> group_id_;
     std::vector<std::pair<int, int>> groups_raw_;
     std::vector<int> groups_offset_;
+    std::vector<int> next_pos_;
 };
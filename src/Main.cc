@@ -1,28 +1,22 @@
 #include "doublechoco/Problem.h"
+#include "doublechoco/SolveCache.h"
 #include "doublechoco/Solver.h"
 
+#include "Batch.h"
+#include "ResultCache.h"
+
+#include <algorithm>
 #include <cstdlib>
+#include <fstream>
+#include <iostream>
 #include <string>
 
 using namespace doublechoco;
 
-int main(int argc, char** argv) {
-    std::optional<Problem> problem_opt = Problem::ParseURL(argv[1]);
-    if (!problem_opt) {
-        printf("Error: invalid url\n");
-        return 0;
-    }
-    Problem problem = *problem_opt;
+void PrintAnswer(const Problem& problem, const DoublechocoAnswer& ans) {
     int height = problem.height();
     int width = problem.width();
 
-    std::optional<DoublechocoAnswer> ans = Solve(problem);
-    if (!ans) {
-        printf("No answer\n");
-        return 0;
-    }
-    assert(ans.has_value());
-
     for (int y = -1; y < height * 2; ++y) {
         for (int x = -1; x < width * 2; ++x) {
             if ((y & 1) == 0 && (x & 1) == 0) {
@@ -34,7 +28,7 @@ int main(int argc, char** argv) {
                     printf("-");
                     continue;
                 }
-                switch (ans->vertical[y / 2][x / 2]) {
+                switch (ans.vertical[y / 2][x / 2]) {
                 case DoublechocoAnswer::Border::kUndecided:
                     printf("?");
                     break;
@@ -50,7 +44,7 @@ int main(int argc, char** argv) {
                     printf("|");
                     continue;
                 }
-                switch (ans->horizontal[y / 2][x / 2]) {
+                switch (ans.horizontal[y / 2][x / 2]) {
                 case DoublechocoAnswer::Border::kUndecided:
                     printf("?");
                     break;
@@ -66,6 +60,210 @@ int main(int argc, char** argv) {
         printf("\n");
     }
     printf("\n");
+}
+
+// Borders as one string per row: '1' for walls, '0' for connected borders and '?' for undecided ones
+std::string AnswerToJson(const DoublechocoAnswer& ans) {
+    auto rows_to_json = [](const std::vector<std::vector<DoublechocoAnswer::Border>>& rows) {
+        std::string ret = "[";
+        for (size_t i = 0; i < rows.size(); ++i) {
+            if (i > 0) {
+                ret += ",";
+            }
+            ret += "\"";
+            for (DoublechocoAnswer::Border b : rows[i]) {
+                switch (b) {
+                case DoublechocoAnswer::Border::kUndecided:
+                    ret += '?';
+                    break;
+                case DoublechocoAnswer::Border::kWall:
+                    ret += '1';
+                    break;
+                case DoublechocoAnswer::Border::kConnected:
+                    ret += '0';
+                    break;
+                }
+            }
+            ret += "\"";
+        }
+        return ret + "]";
+    };
+    return "{\"horizontal\":" + rows_to_json(ans.horizontal) + ",\"vertical\":" + rows_to_json(ans.vertical) + "}";
+}
+
+// Results of puzzles solved before are taken from `cache` unless it is null
+BatchResult SolveForBatch(const std::string& url, const SolverOptions& base_options, const SolveBudget& budget,
+                          bool check_uniqueness, ResultCache* cache) {
+    BatchResult ret;
+    std::optional<Problem> problem = Problem::ParseURL(url);
+    if (!problem) {
+        ret.status = "invalid_url";
+        return ret;
+    }
+
+    SearchStats stats;
+    SolverOptions options = base_options;
+    options.search_stats = &stats;
+
+    if (check_uniqueness) {
+        UniquenessResult res = CheckUniquenessLimited(*problem, budget, options);
+        switch (res.status) {
+        case UniquenessResult::kNoAnswer:
+            ret.status = "no_answer";
+            break;
+        case UniquenessResult::kUnique:
+            ret.status = "unique";
+            break;
+        case UniquenessResult::kMultiple:
+            ret.status = "multiple";
+            break;
+        case UniquenessResult::kUnknown:
+            ret.status = "unknown";
+            break;
+        }
+        if (res.first) {
+            ret.answer_json = AnswerToJson(*res.first);
+        }
+    } else {
+        SolveResult res = cache != nullptr ? SolveCached(*problem, *cache, budget, options)
+                                           : SolveLimited(*problem, budget, options);
+        switch (res.status) {
+        case SolveResult::kSolved:
+            ret.status = "solved";
+            break;
+        case SolveResult::kNoAnswer:
+            ret.status = "no_answer";
+            break;
+        case SolveResult::kUnknown:
+            ret.status = "unknown";
+            break;
+        }
+        if (res.answer) {
+            ret.answer_json = AnswerToJson(*res.answer);
+        }
+    }
+    ret.conflicts = stats.conflicts;
+    return ret;
+}
+
+int main(int argc, char** argv) {
+    // Usage: doublechoco-solver [--no-balancer] [--threads <n>] [--portfolio <n>] [--cube-and-conquer]
+    //                          [--time-limit <ms>] [--conflict-limit <n>] [--check-uniqueness] <url>
+    //        doublechoco-solver [options above] --batch [--jobs <n>] [--cache-size <n>] [--cache-file <path>]
+    //                           [file of URLs, one per line (default: stdin)]
+    // In batch mode, one JSON object per URL is written to stdout in the input order (see `RunBatch`). With a cache,
+    // puzzles equal up to rotations and reflections to those solved before (in this run, or in `--cache-file`) are not
+    // solved again.
+    // The limits apply to each puzzle, with or without `--check-uniqueness`.
+    SolverOptions options;
+    bool check_uniqueness = false;
+    bool batch = false;
+    int num_jobs = 1;
+    size_t cache_size = 0;
+    const char* cache_file = nullptr;
+    SolveBudget budget;
+    const char* url = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--no-balancer") {
+            options.use_balancer = false;
+        } else if (std::string(argv[i]) == "--balancer") {
+            // The default, accepted for compatibility
+            options.use_balancer = true;
+        } else if (std::string(argv[i]) == "--threads" && i + 1 < argc) {
+            options.num_threads = std::max(std::atoi(argv[++i]), 1);
+        } else if (std::string(argv[i]) == "--portfolio" && i + 1 < argc) {
+            options.portfolio_size = std::max(std::atoi(argv[++i]), 1);
+        } else if (std::string(argv[i]) == "--cube-and-conquer") {
+            options.use_cube_and_conquer = true;
+        } else if (std::string(argv[i]) == "--check-uniqueness") {
+            check_uniqueness = true;
+        } else if (std::string(argv[i]) == "--batch") {
+            batch = true;
+        } else if (std::string(argv[i]) == "--jobs" && i + 1 < argc) {
+            num_jobs = std::max(std::atoi(argv[++i]), 1);
+        } else if (std::string(argv[i]) == "--cache-size" && i + 1 < argc) {
+            cache_size = std::max(std::atoll(argv[++i]), 0LL);
+        } else if (std::string(argv[i]) == "--cache-file" && i + 1 < argc) {
+            cache_file = argv[++i];
+        } else if (std::string(argv[i]) == "--time-limit" && i + 1 < argc) {
+            budget.time_limit_ms = std::atoll(argv[++i]);
+        } else if (std::string(argv[i]) == "--conflict-limit" && i + 1 < argc) {
+            budget.conflict_limit = std::atoll(argv[++i]);
+        } else {
+            url = argv[i];
+        }
+    }
+    if (batch) {
+        std::ifstream file;
+        if (url != nullptr) {
+            file.open(url);
+            if (!file) {
+                printf("Error: cannot open %s\n", url);
+                return 1;
+            }
+        }
+        ResultCache cache_body(cache_size);
+        if (cache_file != nullptr && !cache_body.OpenStore(cache_file)) {
+            printf("Error: cannot open cache file %s\n", cache_file);
+            return 1;
+        }
+        ResultCache* cache = cache_size > 0 || cache_file != nullptr ? &cache_body : nullptr;
+        RunBatch(url != nullptr ? file : std::cin, std::cout, num_jobs,
+                 [&](const std::string& u) { return SolveForBatch(u, options, budget, check_uniqueness, cache); });
+        return 0;
+    }
+
+    if (url == nullptr) {
+        printf("Error: no url is given\n");
+        return 0;
+    }
+
+    std::optional<Problem> problem_opt = Problem::ParseURL(url);
+    if (!problem_opt) {
+        printf("Error: invalid url\n");
+        return 0;
+    }
+    Problem problem = *problem_opt;
+
+    if (check_uniqueness) {
+        UniquenessResult res = CheckUniquenessLimited(problem, budget, options);
+        switch (res.status) {
+        case UniquenessResult::kNoAnswer:
+            printf("No answer\n");
+            break;
+        case UniquenessResult::kUnknown:
+            printf("Unknown (the limit is exceeded)\n");
+            if (res.first) {
+                PrintAnswer(problem, *res.first);
+            }
+            break;
+        case UniquenessResult::kUnique:
+            printf("Unique\n");
+            PrintAnswer(problem, *res.first);
+            break;
+        case UniquenessResult::kMultiple:
+            printf("Multiple answers\n");
+            PrintAnswer(problem, *res.first);
+            PrintAnswer(problem, *res.second);
+            break;
+        }
+        return 0;
+    }
+
+    SolveResult res = SolveLimited(problem, budget, options);
+    if (res.status == SolveResult::kNoAnswer) {
+        printf("No answer\n");
+        return 0;
+    }
+    if (res.status == SolveResult::kUnknown) {
+        printf("Unknown (the limit is exceeded)\n");
+        if (!res.answer) {
+            return 0;
+        }
+    }
+    assert(res.answer.has_value());
+
+    PrintAnswer(problem, *res.answer);
 
     return 0;
 }
@@ -0,0 +1,71 @@
+#include "Portfolio.h"
+
+#include <cassert>
+
+#ifndef __EMSCRIPTEN__
+#include <atomic>
+#include <thread>
+#endif
+
+void DiversifySolver(Glucose::Solver& solver, int index) {
+    if (index == 0) {
+        return;
+    }
+    solver.random_seed = 91648253 + 1000003.0 * index;
+    solver.rnd_init_act = true;
+    solver.random_var_freq = (index % 4) * 0.01;
+    // phase saving: 0 (none), 1 (limited) or 2 (full)
+    solver.phase_saving = index % 3;
+    // Smaller K restarts more often, and larger R blocks restarts more often
+    if (index % 2 == 1) {
+        solver.K = 0.7;
+        solver.R = 1.2;
+    } else {
+        solver.K = 0.9;
+        solver.R = 1.6;
+    }
+}
+
+int SolvePortfolio(const std::vector<Glucose::Solver*>& solvers, Glucose::lbool& result) {
+    assert(!solvers.empty());
+#ifndef __EMSCRIPTEN__
+    if (solvers.size() >= 2) {
+        std::atomic<int> winner(-1);
+        std::vector<Glucose::lbool> results(solvers.size(), l_Undef);
+        std::vector<std::thread> threads;
+        for (int i = 0; i < (int)solvers.size(); ++i) {
+            threads.emplace_back([&, i]() {
+                Glucose::vec<Glucose::Lit> assumptions;
+                results[i] = solvers[i]->solveLimited(assumptions);
+                if (results[i] == l_Undef) {
+                    // interrupted by the winner, or out of budget
+                    return;
+                }
+                int expected = -1;
+                if (winner.compare_exchange_strong(expected, i)) {
+                    for (int j = 0; j < (int)solvers.size(); ++j) {
+                        if (j != i) {
+                            solvers[j]->interrupt();
+                        }
+                    }
+                }
+            });
+        }
+        for (auto& th : threads) {
+            th.join();
+        }
+        for (auto* solver : solvers) {
+            solver->clearInterrupt();
+        }
+        if (winner == -1) {
+            result = l_Undef;
+            return 0;
+        }
+        result = results[winner];
+        return winner;
+    }
+#endif
+    Glucose::vec<Glucose::Lit> assumptions;
+    result = solvers[0]->solveLimited(assumptions);
+    return 0;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <vector>
+
+#include "core/Solver.h"
+
+// Changes the search parameters (random seed, initial activity, phase saving and restart policy) of `solver` for the
+// `index`-th member of a portfolio. The 0-th member keeps the default parameters.
+void DiversifySolver(Glucose::Solver& solver, int index);
+
+// Runs `solve()` on all of `solvers`, which are set up for the same problem, each on its own thread. When one of them
+// finishes, the others are interrupted. Returns the index of the solver which finished first; its answer is `result`
+// (l_True or l_False), and the solver keeps its model. The interrupted solvers can be used again.
+// The solvers are run by `solveLimited`; if none of them finishes (because of interrupts from elsewhere or budgets),
+// `result` is l_Undef and 0 is returned. Without thread support (under Emscripten), only `solvers[0]` is run.
+int SolvePortfolio(const std::vector<Glucose::Solver*>& solvers, Glucose::lbool& result);
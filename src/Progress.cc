@@ -0,0 +1,54 @@
+#include "Progress.h"
+
+#include <utility>
+
+namespace {
+
+// Solver counters are sampled this many times per report interval, so that the reports reflect all solvers of a call
+constexpr int kSamplesPerReport = 4;
+
+} // namespace
+
+ProgressReporter::ProgressReporter(ProgressCallback callback, int64_t interval_ms)
+    : callback_(std::move(callback)), interval_(std::chrono::milliseconds(interval_ms)), next_sample_(0),
+      next_report_(std::chrono::steady_clock::now() + interval_) {}
+
+void ProgressReporter::OnSearch(const Glucose::Solver& solver) {
+    auto now = std::chrono::steady_clock::now();
+    if (now.time_since_epoch().count() < next_sample_.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    next_sample_.store((now + interval_ / kSamplesPerReport).time_since_epoch().count(), std::memory_order_relaxed);
+
+    // A solver created later may have the address of a destroyed one, in which case its counters start over
+    SolverCounters& last = last_counters_[&solver];
+    progress_.conflicts += solver.conflicts >= last.conflicts ? solver.conflicts - last.conflicts : solver.conflicts;
+    progress_.restarts += solver.starts >= last.restarts ? solver.starts - last.restarts : solver.starts;
+    last.conflicts = solver.conflicts;
+    last.restarts = solver.starts;
+
+    ReportIfDue(now);
+}
+
+void ProgressReporter::OnProgress(int num_candidates, int num_proven) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    progress_.num_candidates = num_candidates;
+    progress_.num_fixed = num_proven;
+    ReportIfDue(std::chrono::steady_clock::now());
+}
+
+void ProgressReporter::Flush() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    next_report_ = std::chrono::steady_clock::now() + interval_;
+    callback_(progress_);
+}
+
+void ProgressReporter::ReportIfDue(std::chrono::steady_clock::time_point now) {
+    if (now < next_report_) {
+        return;
+    }
+    next_report_ = now + interval_;
+    callback_(progress_);
+}
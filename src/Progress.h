@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+
+#include "core/Solver.h"
+
+#include "Backbone.h"
+
+// Snapshot of an ongoing solver call
+struct SolveProgress {
+    // Summed over the SAT solvers of the call. Each solver is sampled at its own fixpoints, so with several solvers the
+    // sums lag slightly behind.
+    uint64_t conflicts = 0;
+    uint64_t restarts = 0;
+
+    // Backbone candidates neither proven nor refuted yet, or -1 before the backbone computation starts
+    int num_candidates = -1;
+    // Variables (borders or cells) proven to take the same value in all answers
+    int num_fixed = 0;
+};
+
+using ProgressCallback = std::function<void(const SolveProgress&)>;
+
+// Collects the progress of a solver call from its solvers and its backbone computation, and passes it to a callback at
+// most once per interval. The callback is called on the threads of the solvers, but never concurrently.
+class ProgressReporter : public BackboneObserver {
+public:
+    ProgressReporter(ProgressCallback callback, int64_t interval_ms);
+
+    // Called by the propagators at fixpoints. This is cheap unless a sample is due.
+    void OnSearch(const Glucose::Solver& solver);
+
+    void OnProgress(int num_candidates, int num_proven) override;
+
+    // Reports the latest progress regardless of the interval
+    void Flush();
+
+private:
+    struct SolverCounters {
+        uint64_t conflicts = 0;
+        uint64_t restarts = 0;
+    };
+
+    // `mutex_` must be held
+    void ReportIfDue(std::chrono::steady_clock::time_point now);
+
+    ProgressCallback callback_;
+    std::chrono::steady_clock::duration interval_;
+    // Time of the next sample of solver counters, in ticks of `steady_clock`
+    std::atomic<int64_t> next_sample_;
+
+    std::mutex mutex_;
+    std::unordered_map<const Glucose::Solver*, SolverCounters> last_counters_;
+    SolveProgress progress_;
+    std::chrono::steady_clock::time_point next_report_;
+};
@@ -0,0 +1,171 @@
+#include "PuzzleSolver.h"
+
+#include <optional>
+#include <string>
+#include <variant>
+
+#include "Budget.h"
+#include "Description.h"
+#include "SearchStats.h"
+#include "doublechoco/Problem.h"
+#include "doublechoco/Solver.h"
+#include "evolmino/Problem.h"
+#include "evolmino/Solver.h"
+
+struct PuzzleSolverProblem {
+    std::variant<doublechoco::Problem, evolmino::Problem> problem;
+};
+
+struct PuzzleSolverResult {
+    PuzzleSolverStatus status;
+    std::optional<std::string> description, another;
+    int64_t conflicts;
+};
+
+namespace {
+
+template <typename Problem>
+struct Genre;
+
+template <>
+struct Genre<doublechoco::Problem> {
+    using SolverOptions = doublechoco::SolverOptions;
+
+    static std::string Describe(const doublechoco::Problem& problem, const doublechoco::DoublechocoAnswer& ans) {
+        return DescribeDoublechocoAnswer(problem, ans);
+    }
+};
+
+template <>
+struct Genre<evolmino::Problem> {
+    using SolverOptions = evolmino::SolverOptions;
+
+    static std::string Describe(const evolmino::Problem& problem, const evolmino::EvolminoAnswer& ans) {
+        return DescribeEvolminoAnswer(problem, ans);
+    }
+};
+
+// `SolveLimited` or `FindAnswerLimited` for any genre. The genre functions are found by argument-dependent lookup.
+template <typename Problem>
+PuzzleSolverResult* SolveProblem(const Problem& problem, int64_t time_limit_ms, bool find_one) {
+    SearchStats stats;
+    typename Genre<Problem>::SolverOptions options;
+    options.search_stats = &stats;
+    SolveBudget budget;
+    budget.time_limit_ms = time_limit_ms;
+
+    auto res = find_one ? FindAnswerLimited(problem, budget, options) : SolveLimited(problem, budget, options);
+    using SolveResult = decltype(res);
+
+    auto ret = new PuzzleSolverResult();
+    switch (res.status) {
+        case SolveResult::kSolved:
+            ret->status = PUZZLESOLVER_SOLVED;
+            break;
+        case SolveResult::kNoAnswer:
+            ret->status = PUZZLESOLVER_NO_ANSWER;
+            break;
+        case SolveResult::kUnknown:
+            ret->status = PUZZLESOLVER_UNKNOWN;
+            break;
+    }
+    if (res.answer) {
+        ret->description = Genre<Problem>::Describe(problem, *res.answer);
+    }
+    ret->conflicts = stats.conflicts;
+    return ret;
+}
+
+template <typename Problem>
+PuzzleSolverResult* CheckProblemUniqueness(const Problem& problem, int64_t time_limit_ms) {
+    SearchStats stats;
+    typename Genre<Problem>::SolverOptions options;
+    options.search_stats = &stats;
+    SolveBudget budget;
+    budget.time_limit_ms = time_limit_ms;
+
+    auto res = CheckUniquenessLimited(problem, budget, options);
+    using UniquenessResult = decltype(res);
+
+    auto ret = new PuzzleSolverResult();
+    switch (res.status) {
+        case UniquenessResult::kNoAnswer:
+            ret->status = PUZZLESOLVER_NO_ANSWER;
+            break;
+        case UniquenessResult::kUnique:
+            ret->status = PUZZLESOLVER_UNIQUE;
+            break;
+        case UniquenessResult::kMultiple:
+            ret->status = PUZZLESOLVER_MULTIPLE;
+            break;
+        case UniquenessResult::kUnknown:
+            ret->status = PUZZLESOLVER_UNKNOWN;
+            break;
+    }
+    if (res.first) {
+        ret->description = Genre<Problem>::Describe(problem, *res.first);
+    }
+    if (res.second) {
+        ret->another = Genre<Problem>::Describe(problem, *res.second);
+    }
+    ret->conflicts = stats.conflicts;
+    return ret;
+}
+
+} // namespace
+
+// No exception may propagate to the C caller: failures (malformed URLs make `std::stoi` throw, for example) are
+// reported as NULL.
+
+PuzzleSolverProblem* puzzlesolver_parse(const char* url) {
+    try {
+        if (auto problem = doublechoco::Problem::ParseURL(url)) {
+            return new PuzzleSolverProblem{*problem};
+        }
+        if (auto problem = evolmino::Problem::ParseURL(url)) {
+            return new PuzzleSolverProblem{*problem};
+        }
+    } catch (...) {
+    }
+    return nullptr;
+}
+
+void puzzlesolver_free_problem(PuzzleSolverProblem* problem) { delete problem; }
+
+PuzzleSolverResult* puzzlesolver_solve(const PuzzleSolverProblem* problem, int64_t time_limit_ms) {
+    try {
+        return std::visit([&](const auto& p) { return SolveProblem(p, time_limit_ms, false); }, problem->problem);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+PuzzleSolverResult* puzzlesolver_find_answer(const PuzzleSolverProblem* problem, int64_t time_limit_ms) {
+    try {
+        return std::visit([&](const auto& p) { return SolveProblem(p, time_limit_ms, true); }, problem->problem);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+PuzzleSolverResult* puzzlesolver_check_uniqueness(const PuzzleSolverProblem* problem, int64_t time_limit_ms) {
+    try {
+        return std::visit([&](const auto& p) { return CheckProblemUniqueness(p, time_limit_ms); }, problem->problem);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+PuzzleSolverStatus puzzlesolver_result_status(const PuzzleSolverResult* result) { return result->status; }
+
+const char* puzzlesolver_result_description(const PuzzleSolverResult* result) {
+    return result->description ? result->description->c_str() : nullptr;
+}
+
+const char* puzzlesolver_result_another(const PuzzleSolverResult* result) {
+    return result->another ? result->another->c_str() : nullptr;
+}
+
+int64_t puzzlesolver_result_conflicts(const PuzzleSolverResult* result) { return result->conflicts; }
+
+void puzzlesolver_free_result(PuzzleSolverResult* result) { delete result; }
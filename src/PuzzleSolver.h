@@ -0,0 +1,49 @@
+#pragma once
+
+// C API of the solvers, for embedding them in other programs. All functions are reentrant: problems and results are
+// independent objects, so any number of threads may parse and solve concurrently. A problem may be shared by threads
+// as long as it is not freed while in use.
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct PuzzleSolverProblem PuzzleSolverProblem;
+typedef struct PuzzleSolverResult PuzzleSolverResult;
+
+typedef enum {
+    PUZZLESOLVER_SOLVED,
+    PUZZLESOLVER_NO_ANSWER,
+    // The time limit is exceeded before the call completes
+    PUZZLESOLVER_UNKNOWN,
+    PUZZLESOLVER_UNIQUE,
+    PUZZLESOLVER_MULTIPLE,
+} PuzzleSolverStatus;
+
+// Parses a puzz.link URL of any supported genre. Returns NULL if the URL is invalid.
+PuzzleSolverProblem* puzzlesolver_parse(const char* url);
+void puzzlesolver_free_problem(PuzzleSolverProblem* problem);
+
+// Finds the cells / borders common to all answers (`SOLVED`, `NO_ANSWER` or `UNKNOWN`). A negative `time_limit_ms`
+// means no limit. On `UNKNOWN`, the description is the part decided before the time limit, if any.
+PuzzleSolverResult* puzzlesolver_solve(const PuzzleSolverProblem* problem, int64_t time_limit_ms);
+// Finds any one answer (`SOLVED`, `NO_ANSWER` or `UNKNOWN`)
+PuzzleSolverResult* puzzlesolver_find_answer(const PuzzleSolverProblem* problem, int64_t time_limit_ms);
+// Determines whether the answer is unique (`UNIQUE`, `MULTIPLE`, `NO_ANSWER` or `UNKNOWN`). On `UNKNOWN`, the
+// description is an answer if one was found before the time limit.
+PuzzleSolverResult* puzzlesolver_check_uniqueness(const PuzzleSolverProblem* problem, int64_t time_limit_ms);
+
+PuzzleSolverStatus puzzlesolver_result_status(const PuzzleSolverResult* result);
+// JSON description of the answer in the format of the puzzle renderer, or NULL if there is none. With `MULTIPLE`,
+// `puzzlesolver_result_another` is the other answer. The strings are owned by `result`.
+const char* puzzlesolver_result_description(const PuzzleSolverResult* result);
+const char* puzzlesolver_result_another(const PuzzleSolverResult* result);
+// Search conflicts spent on the result
+int64_t puzzlesolver_result_conflicts(const PuzzleSolverResult* result);
+void puzzlesolver_free_result(PuzzleSolverResult* result);
+
+#ifdef __cplusplus
+}
+#endif
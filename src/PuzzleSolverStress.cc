@@ -0,0 +1,114 @@
+#include "PuzzleSolver.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Status and answers of all the calls of the C API for `problem`, to compare results across threads
+std::string Signature(const PuzzleSolverProblem* problem) {
+    std::string ret;
+    auto append = [&](PuzzleSolverResult* result) {
+        if (result == nullptr) {
+            ret += "error;";
+            return;
+        }
+        ret += std::to_string(puzzlesolver_result_status(result)) + ";";
+        const char* description = puzzlesolver_result_description(result);
+        ret += std::string(description != nullptr ? description : "-") + ";";
+        const char* another = puzzlesolver_result_another(result);
+        ret += std::string(another != nullptr ? another : "-") + ";";
+        puzzlesolver_free_result(result);
+    };
+    append(puzzlesolver_solve(problem, -1));
+    append(puzzlesolver_find_answer(problem, -1));
+    append(puzzlesolver_check_uniqueness(problem, -1));
+    return ret;
+}
+
+// Solves the given puzzles concurrently through the C API, and checks that every thread gets the same results as a
+// sequential run.
+// Usage: puzzlesolver-stress [--threads <n>] [--rounds <n>] [file of puzzle URLs, one per line (default: stdin)]
+int main(int argc, char** argv) {
+    int num_threads = std::max<int>(std::thread::hardware_concurrency(), 2);
+    int num_rounds = 4;
+    const char* path = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--threads" && i + 1 < argc) {
+            num_threads = std::max(std::atoi(argv[++i]), 1);
+        } else if (std::string(argv[i]) == "--rounds" && i + 1 < argc) {
+            num_rounds = std::max(std::atoi(argv[++i]), 1);
+        } else {
+            path = argv[i];
+        }
+    }
+
+    std::vector<std::string> urls;
+    {
+        std::ifstream file;
+        if (path != nullptr) {
+            file.open(path);
+            if (!file) {
+                printf("Error: cannot open %s\n", path);
+                return 1;
+            }
+        }
+        std::istream& in = path != nullptr ? file : std::cin;
+        std::string line;
+        while (std::getline(in, line)) {
+            if (!line.empty()) {
+                urls.push_back(line);
+            }
+        }
+    }
+
+    // Problems parsed once are shared by all threads; each thread also parses its own copies
+    std::vector<PuzzleSolverProblem*> shared_problems;
+    std::vector<std::string> expected;
+    for (auto& url : urls) {
+        PuzzleSolverProblem* problem = puzzlesolver_parse(url.c_str());
+        shared_problems.push_back(problem);
+        expected.push_back(problem != nullptr ? Signature(problem) : "invalid");
+    }
+
+    std::atomic<int> num_calls(0), num_mismatches(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&, t]() {
+            for (int round = 0; round < num_rounds; ++round) {
+                for (size_t k = 0; k < urls.size(); ++k) {
+                    // Different threads work on different puzzles at the same time
+                    size_t i = (k + t + round) % urls.size();
+                    std::string actual;
+                    if (round % 2 == 0) {
+                        actual = shared_problems[i] != nullptr ? Signature(shared_problems[i]) : "invalid";
+                    } else {
+                        PuzzleSolverProblem* problem = puzzlesolver_parse(urls[i].c_str());
+                        actual = problem != nullptr ? Signature(problem) : "invalid";
+                        puzzlesolver_free_problem(problem);
+                    }
+                    ++num_calls;
+                    if (actual != expected[i]) {
+                        ++num_mismatches;
+                        printf("Mismatch (thread %d): %s\n", t, urls[i].c_str());
+                    }
+                }
+            }
+        });
+    }
+    for (auto& th : threads) {
+        th.join();
+    }
+    for (auto problem : shared_problems) {
+        puzzlesolver_free_problem(problem);
+    }
+
+    printf("%d threads, %d puzzles, %d calls, %d mismatches\n", num_threads, (int)urls.size(), num_calls.load(),
+           num_mismatches.load());
+    return num_mismatches > 0 ? 1 : 0;
+}
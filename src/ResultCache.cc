@@ -0,0 +1,231 @@
+#include "ResultCache.h"
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string_view>
+
+#ifndef __EMSCRIPTEN__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#ifndef __EMSCRIPTEN__
+
+constexpr char kStoreMagic[8] = {'P', 'Z', 'C', 'A', 'C', 'H', 'E', '1'};
+constexpr size_t kRecordHeaderSize = 8; // key size and value size, as 32-bit integers
+
+bool WriteAt(int fd, const char* data, size_t size, size_t offset) {
+    while (size > 0) {
+        ssize_t n = pwrite(fd, data, size, offset);
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        size -= n;
+        offset += n;
+    }
+    return true;
+}
+
+#endif
+
+} // namespace
+
+ResultCache::ResultCache(size_t capacity)
+    : capacity_(capacity), store_fd_(-1), store_map_(nullptr), store_map_size_(0), store_size_(0) {}
+
+ResultCache::~ResultCache() { CloseStore(); }
+
+bool ResultCache::OpenStore(const std::string& path) {
+#ifdef __EMSCRIPTEN__
+    return false;
+#else
+    std::lock_guard<std::mutex> lock(mutex_);
+    CloseStore();
+
+    store_fd_ = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (store_fd_ < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(store_fd_, &st) != 0) {
+        CloseStore();
+        return false;
+    }
+    store_size_ = st.st_size;
+    if (store_size_ == 0) {
+        if (!WriteAt(store_fd_, kStoreMagic, sizeof(kStoreMagic), 0)) {
+            CloseStore();
+            return false;
+        }
+        store_size_ = sizeof(kStoreMagic);
+    }
+    if (!MapStore() || memcmp(store_map_, kStoreMagic, sizeof(kStoreMagic)) != 0) {
+        CloseStore();
+        return false;
+    }
+
+    size_t pos = sizeof(kStoreMagic);
+    while (pos + kRecordHeaderSize <= store_map_size_) {
+        uint32_t key_size, value_size;
+        memcpy(&key_size, store_map_ + pos, 4);
+        memcpy(&value_size, store_map_ + pos + 4, 4);
+        size_t record_size = kRecordHeaderSize + (size_t)key_size + value_size;
+        if (pos + record_size > store_map_size_) {
+            break;
+        }
+        std::string_view key(store_map_ + pos + kRecordHeaderSize, key_size);
+        store_index_.emplace(std::hash<std::string_view>{}(key), pos);
+        pos += record_size;
+    }
+    if (pos != store_size_) {
+        // Discard the truncated record so that new records are appended right after the valid ones
+        store_size_ = pos;
+        if (ftruncate(store_fd_, store_size_) != 0) {
+            CloseStore();
+            return false;
+        }
+    }
+    return true;
+#endif
+}
+
+std::optional<std::string> ResultCache::Get(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = lru_index_.find(key);
+    if (it != lru_index_.end()) {
+        lru_.splice(lru_.begin(), lru_, it->second);
+        return it->second->second;
+    }
+
+    std::optional<std::string> value = GetFromStore(key);
+    if (value) {
+        InsertToLru(key, *value);
+    }
+    return value;
+}
+
+void ResultCache::Put(const std::string& key, const std::string& value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = lru_index_.find(key);
+    if (it != lru_index_.end()) {
+        it->second->second = value;
+        lru_.splice(lru_.begin(), lru_, it->second);
+    } else {
+        InsertToLru(key, value);
+    }
+    if (store_fd_ >= 0 && !FindInStore(key)) {
+        AppendToStore(key, value);
+    }
+}
+
+void ResultCache::InsertToLru(const std::string& key, const std::string& value) {
+    if (capacity_ == 0) {
+        return;
+    }
+    lru_.emplace_front(key, value);
+    lru_index_[key] = lru_.begin();
+    while (lru_.size() > capacity_) {
+        lru_index_.erase(lru_.back().first);
+        lru_.pop_back();
+    }
+}
+
+std::optional<std::string> ResultCache::GetFromStore(const std::string& key) {
+#ifdef __EMSCRIPTEN__
+    return std::nullopt;
+#else
+    std::optional<size_t> pos = FindInStore(key);
+    if (!pos) {
+        return std::nullopt;
+    }
+    uint32_t value_size;
+    memcpy(&value_size, store_map_ + *pos + 4, 4);
+    return std::string(store_map_ + *pos + kRecordHeaderSize + key.size(), value_size);
+#endif
+}
+
+std::optional<size_t> ResultCache::FindInStore(const std::string& key) {
+#ifdef __EMSCRIPTEN__
+    return std::nullopt;
+#else
+    if (store_fd_ < 0) {
+        return std::nullopt;
+    }
+    auto [begin, end] = store_index_.equal_range(std::hash<std::string_view>{}(key));
+    for (auto it = begin; it != end; ++it) {
+        size_t pos = it->second;
+        if (pos + kRecordHeaderSize > store_map_size_ && !MapStore()) {
+            return std::nullopt;
+        }
+        uint32_t key_size, value_size;
+        memcpy(&key_size, store_map_ + pos, 4);
+        memcpy(&value_size, store_map_ + pos + 4, 4);
+        size_t record_size = kRecordHeaderSize + (size_t)key_size + value_size;
+        if (pos + record_size > store_map_size_ && !MapStore()) {
+            return std::nullopt;
+        }
+        if (key_size == key.size() && memcmp(store_map_ + pos + kRecordHeaderSize, key.data(), key_size) == 0) {
+            return pos;
+        }
+    }
+    return std::nullopt;
+#endif
+}
+
+void ResultCache::AppendToStore(const std::string& key, const std::string& value) {
+#ifndef __EMSCRIPTEN__
+    uint32_t key_size = key.size(), value_size = value.size();
+    std::string record(kRecordHeaderSize, '\0');
+    memcpy(&record[0], &key_size, 4);
+    memcpy(&record[4], &value_size, 4);
+    record += key;
+    record += value;
+    if (!WriteAt(store_fd_, record.data(), record.size(), store_size_)) {
+        // Keep the store consistent: a partially written record is overwritten by the next append
+        return;
+    }
+    store_index_.emplace(std::hash<std::string_view>{}(key), store_size_);
+    store_size_ += record.size();
+#endif
+}
+
+bool ResultCache::MapStore() {
+#ifdef __EMSCRIPTEN__
+    return false;
+#else
+    if (store_map_ != nullptr) {
+        munmap((void*)store_map_, store_map_size_);
+        store_map_ = nullptr;
+        store_map_size_ = 0;
+    }
+    void* map = mmap(nullptr, store_size_, PROT_READ, MAP_SHARED, store_fd_, 0);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    store_map_ = (const char*)map;
+    store_map_size_ = store_size_;
+    return true;
+#endif
+}
+
+void ResultCache::CloseStore() {
+#ifndef __EMSCRIPTEN__
+    if (store_map_ != nullptr) {
+        munmap((void*)store_map_, store_map_size_);
+    }
+    if (store_fd_ >= 0) {
+        close(store_fd_);
+    }
+#endif
+    store_fd_ = -1;
+    store_map_ = nullptr;
+    store_map_size_ = 0;
+    store_size_ = 0;
+    store_index_.clear();
+}
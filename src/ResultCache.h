@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+// Thread-safe cache of solver results as opaque strings, with an in-memory LRU and an optional on-disk store.
+//
+// The store is an append-only file of records (key size, value size, key, value), which is memory-mapped for lookups.
+// Entries are looked up in the store on misses of the LRU, and every new entry is appended to it, so the store keeps
+// all the results across restarts. The store is indexed in memory by key hashes (not keys), so the index takes a few
+// dozen bytes per record regardless of the key size. A store must not be opened by more than one process at a time.
+// Without a file system (under Emscripten), only the LRU is available.
+class ResultCache {
+public:
+    // `capacity` is the maximum number of entries in the LRU
+    explicit ResultCache(size_t capacity);
+    ~ResultCache();
+
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+
+    // Opens the store at `path`, creating it if it does not exist. A truncated record at the end (e.g. after a crash)
+    // is discarded. Returns false on failure, in which case the cache works without the store.
+    bool OpenStore(const std::string& path);
+
+    std::optional<std::string> Get(const std::string& key);
+    void Put(const std::string& key, const std::string& value);
+
+private:
+    using LruList = std::list<std::pair<std::string, std::string>>;
+
+    // The following functions require `mutex_` to be held.
+    void InsertToLru(const std::string& key, const std::string& value);
+    std::optional<std::string> GetFromStore(const std::string& key);
+    // Returns the offset of the record of `key` in the store, or std::nullopt if there is no such record
+    std::optional<size_t> FindInStore(const std::string& key);
+    void AppendToStore(const std::string& key, const std::string& value);
+    bool MapStore();
+    void CloseStore();
+
+    std::mutex mutex_;
+
+    size_t capacity_;
+    LruList lru_; // most recently used first
+    std::unordered_map<std::string, LruList::iterator> lru_index_;
+
+    int store_fd_;
+    const char* store_map_;
+    size_t store_map_size_; // size of the mapped region, which may be smaller than `store_size_` after appends
+    size_t store_size_;     // size of the valid part of the store
+    // Offsets of the records in the store by the hash of their keys. Keys with the same hash are told apart by comparing
+    // them with the keys in the store.
+    std::unordered_multimap<size_t, size_t> store_index_;
+};
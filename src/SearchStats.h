@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+
+#include "core/Solver.h"
+
+// Counters of the CDCL search of SAT solvers
+struct SearchStats {
+    uint64_t conflicts = 0;
+    uint64_t decisions = 0;
+    uint64_t propagations = 0;
+    uint64_t learnt_literals = 0; // total length of learnt clauses (after minimization)
+
+    void Add(const Glucose::Solver& solver) {
+        conflicts += solver.conflicts;
+        decisions += solver.decisions;
+        propagations += solver.propagations;
+        learnt_literals += solver.tot_literals;
+    }
+};
@@ -0,0 +1,352 @@
+#include "Budget.h"
+#include "Description.h"
+#include "ResultCache.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Fixed number of threads running submitted tasks in the FIFO order
+class WorkerPool {
+public:
+    explicit WorkerPool(int num_threads) : stopped_(false) {
+        for (int i = 0; i < num_threads; ++i) {
+            threads_.emplace_back([this]() { Run(); });
+        }
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopped_ = true;
+        }
+        cv_.notify_all();
+        for (auto& th : threads_) {
+            th.join();
+        }
+    }
+
+    std::future<std::string> Submit(std::function<std::string()> task) {
+        auto packaged = std::make_shared<std::packaged_task<std::string()>>(std::move(task));
+        std::future<std::string> ret = packaged->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tasks_.push_back([packaged]() { (*packaged)(); });
+        }
+        cv_.notify_one();
+        return ret;
+    }
+
+private:
+    void Run() {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [&]() { return stopped_ || !tasks_.empty(); });
+                if (tasks_.empty()) {
+                    return;
+                }
+                task = std::move(tasks_.front());
+                tasks_.pop_front();
+            }
+            task();
+        }
+    }
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::function<void()>> tasks_;
+    bool stopped_;
+    std::vector<std::thread> threads_;
+};
+
+// Threads serving connections. Finished threads are joined whenever a new one is started, and the remaining ones on
+// destruction, so no thread outlives the state shared with them as long as this is destroyed before that state.
+class ConnectionThreads {
+public:
+    ~ConnectionThreads() {
+        for (auto& connection : connections_) {
+            connection.thread.join();
+        }
+    }
+
+    void Start(std::function<void()> serve) {
+        for (auto it = connections_.begin(); it != connections_.end();) {
+            if (it->finished) {
+                it->thread.join();
+                it = connections_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        Connection& connection = connections_.emplace_back();
+        connection.thread = std::thread([&connection, serve = std::move(serve)]() {
+            serve();
+            connection.finished = true;
+        });
+    }
+
+private:
+    struct Connection {
+        std::thread thread;
+        std::atomic<bool> finished{false};
+    };
+
+    std::list<Connection> connections_;
+};
+
+// Reads `fd` line by line
+class LineReader {
+public:
+    explicit LineReader(int fd) : fd_(fd) {}
+
+    // Stores the next line (without the line terminator) to `line`. Returns false at the end of input.
+    bool ReadLine(std::string& line) {
+        for (;;) {
+            size_t pos = buffer_.find('\n');
+            if (pos != std::string::npos) {
+                line = buffer_.substr(0, pos);
+                buffer_.erase(0, pos + 1);
+                if (!line.empty() && line.back() == '\r') {
+                    line.pop_back();
+                }
+                return true;
+            }
+            char chunk[4096];
+            ssize_t n = read(fd_, chunk, sizeof(chunk));
+            if (n <= 0) {
+                if (buffer_.empty()) {
+                    return false;
+                }
+                line = std::move(buffer_);
+                buffer_.clear();
+                return true;
+            }
+            buffer_.append(chunk, n);
+        }
+    }
+
+private:
+    int fd_;
+    std::string buffer_;
+};
+
+bool WriteAll(int fd, const std::string& data) {
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t n = write(fd, data.data() + written, data.size() - written);
+        if (n <= 0) {
+            return false;
+        }
+        written += n;
+    }
+    return true;
+}
+
+// Solves the request `line`, which is a puzzle URL optionally followed by a time limit in milliseconds. The time limit
+// counts from `received`, so the time spent waiting for a worker is included. The call stops soon after `cancellation`
+// is cancelled.
+std::string HandleRequest(const std::string& line, std::chrono::steady_clock::time_point received,
+                          int64_t default_time_limit_ms, ResultCache* cache, const CancellationToken* cancellation) {
+    std::string url = line;
+    int64_t time_limit_ms = default_time_limit_ms;
+    size_t space = line.find(' ');
+    if (space != std::string::npos) {
+        url = line.substr(0, space);
+        time_limit_ms = std::atoll(line.c_str() + space + 1);
+    }
+
+    SolveBudget budget;
+    budget.cancellation = cancellation;
+    if (time_limit_ms >= 0) {
+        int64_t elapsed_ms =
+            std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - received).count();
+        budget.time_limit_ms = std::max<int64_t>(time_limit_ms - elapsed_ms, 0);
+    }
+    return SolveToDescription(url, budget, cache);
+}
+
+// Serves the requests (one per line) read from `in_fd`, and writes the responses (one per line) to `out_fd` in the
+// request order. Requests are solved on `pool` as soon as they are read, so a client may send many requests without
+// waiting for the responses. Once the client is gone (writing a response fails, or with `cancel_at_end_of_input`, the
+// input ends), the requests of the connection still queued or running are cancelled.
+void ServeConnection(int in_fd, int out_fd, WorkerPool& pool, int64_t default_time_limit_ms, ResultCache* cache,
+                     bool cancel_at_end_of_input) {
+    // Shared by the requests of this connection. It outlives them since all the responses are awaited below.
+    CancellationToken cancellation;
+    std::mutex mutex;
+    std::condition_variable cv;
+    // nullopt marks the end of the requests
+    std::deque<std::optional<std::future<std::string>>> responses;
+
+    std::thread writer([&]() {
+        bool ok = true;
+        for (;;) {
+            std::optional<std::future<std::string>> response;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&]() { return !responses.empty(); });
+                response = std::move(responses.front());
+                responses.pop_front();
+            }
+            if (!response) {
+                break;
+            }
+            // Even after the client has gone, the responses are awaited so that no task outlives this connection
+            std::string body = response->get();
+            if (ok && !cancellation.IsCancelled()) {
+                ok = WriteAll(out_fd, body + "\n");
+                if (!ok) {
+                    cancellation.Cancel();
+                }
+            }
+        }
+    });
+
+    LineReader reader(in_fd);
+    std::string line;
+    while (reader.ReadLine(line)) {
+        if (line.empty()) {
+            continue;
+        }
+        auto received = std::chrono::steady_clock::now();
+        std::future<std::string> response =
+            pool.Submit([line, received, default_time_limit_ms, cache, &cancellation]() -> std::string {
+                // The response of a cancelled request is never written
+                if (cancellation.IsCancelled()) {
+                    return "";
+                }
+                return HandleRequest(line, received, default_time_limit_ms, cache, &cancellation);
+            });
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            responses.push_back(std::move(response));
+        }
+        cv.notify_one();
+    }
+    if (cancel_at_end_of_input) {
+        cancellation.Cancel();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        responses.push_back(std::nullopt);
+    }
+    cv.notify_one();
+    writer.join();
+}
+
+int main(int argc, char** argv) {
+    // Usage: solver-server [--socket <path>] [--jobs <n>] [--time-limit <ms>] [--cache-size <n>]
+    //                      [--cache-file <path>]
+    // Each request is a line consisting of a puzzle URL of any supported genre, optionally followed by a space and a
+    // time limit in milliseconds which overrides `--time-limit`. Each response is a line of the JSON returned by
+    // `SolveToDescription`, in the order of the requests of the connection. Without `--socket`, requests are read from
+    // stdin and the responses are written to stdout. Results are cached in memory (`--cache-size` entries, 0 to
+    // disable) and, with `--cache-file`, in a file which persists across restarts. A socket client must not shut down
+    // its side of the connection before reading all the responses, since the end of its input is taken as a
+    // disconnection and cancels the pending requests.
+    const char* socket_path = nullptr;
+    int num_jobs = std::max<int>(std::thread::hardware_concurrency(), 1);
+    int64_t time_limit_ms = -1;
+    size_t cache_size = 4096;
+    const char* cache_file = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--socket" && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else if (std::string(argv[i]) == "--jobs" && i + 1 < argc) {
+            num_jobs = std::max(std::atoi(argv[++i]), 1);
+        } else if (std::string(argv[i]) == "--time-limit" && i + 1 < argc) {
+            time_limit_ms = std::atoll(argv[++i]);
+        } else if (std::string(argv[i]) == "--cache-size" && i + 1 < argc) {
+            cache_size = std::max(std::atoll(argv[++i]), 0LL);
+        } else if (std::string(argv[i]) == "--cache-file" && i + 1 < argc) {
+            cache_file = argv[++i];
+        } else {
+            printf("Error: unknown argument %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    ResultCache cache(cache_size);
+    if (cache_file != nullptr && !cache.OpenStore(cache_file)) {
+        printf("Error: cannot open cache file %s\n", cache_file);
+        return 1;
+    }
+
+    // Writing to a closed connection (or stdout) should fail rather than kill the server
+    signal(SIGPIPE, SIG_IGN);
+
+    WorkerPool pool(num_jobs);
+
+    if (socket_path == nullptr) {
+        // The end of stdin only means that there are no more requests, e.g. when they are piped from a file
+        ServeConnection(0, 1, pool, time_limit_ms, &cache, false);
+        return 0;
+    }
+
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        printf("Error: socket path is too long\n");
+        return 1;
+    }
+    strcpy(addr.sun_path, socket_path);
+
+    int server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server_fd < 0) {
+        perror("socket");
+        return 1;
+    }
+    unlink(socket_path);
+    if (bind(server_fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror("bind");
+        return 1;
+    }
+    if (listen(server_fd, 64) < 0) {
+        perror("listen");
+        return 1;
+    }
+
+    // Declared after `pool` and `cache`, so that the connections are finished before they are destroyed
+    ConnectionThreads connections;
+    for (;;) {
+        int client_fd = accept(server_fd, nullptr, nullptr);
+        if (client_fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("accept");
+            break;
+        }
+        connections.Start([client_fd, &pool, time_limit_ms, &cache]() {
+            ServeConnection(client_fd, client_fd, pool, time_limit_ms, &cache, true);
+            close(client_fd);
+        });
+    }
+
+    close(server_fd);
+    return 1;
+}
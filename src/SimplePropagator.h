@@ -1,7 +1,45 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
 #include "core/Solver.h"
 
+#include "Budget.h"
+#include "Progress.h"
+
+// When the expensive rule tier of a `SimplePropagator` is run.
+enum class ExpensiveTierSchedule {
+    // Every time the cheap tier and the solver's own propagation reach a fixpoint
+    kAtFixpoint,
+    // At fixpoints, but exponentially less often while the expensive tier finds nothing
+    kAdaptive,
+};
+
+// Counters of a `SimplePropagator`, for tuning the split of rules between the tiers.
+struct SimplePropagatorStats {
+    uint64_t cheap_runs = 0;
+    uint64_t cheap_conflicts = 0;
+    uint64_t cheap_implications = 0;
+    uint64_t expensive_runs = 0;
+    uint64_t expensive_conflicts = 0;
+    uint64_t expensive_implications = 0;
+    // Fixpoints at which the expensive tier was not run because of `ExpensiveTierSchedule::kAdaptive`
+    uint64_t expensive_skipped = 0;
+
+    void Merge(const SimplePropagatorStats& other) {
+        cheap_runs += other.cheap_runs;
+        cheap_conflicts += other.cheap_conflicts;
+        cheap_implications += other.cheap_implications;
+        expensive_runs += other.expensive_runs;
+        expensive_conflicts += other.expensive_conflicts;
+        expensive_implications += other.expensive_implications;
+        expensive_skipped += other.expensive_skipped;
+    }
+};
+
 template <typename T>
 class SimplePropagator : public Glucose::Constraint {
 public:
@@ -10,6 +48,17 @@ public:
 
     bool initialize(Glucose::Solver& solver) override final {
         std::vector<Glucose::Var> related_vars = static_cast<T*>(this)->RelatedVariables();
+        num_related_vars_ = related_vars.size();
+        Glucose::Var max_var = -1;
+        for (Glucose::Var var : related_vars) {
+            max_var = std::max(max_var, var);
+        }
+        // Implied literals are not necessarily related ones, but usually they are, so this avoids most resizing
+        implication_reasons_.resize(max_var + 1, {0, 0});
+        // An entry of `reason_offsets_` is added for each decided related variable. The arena has no such bound, but
+        // reasons are usually short, so this avoids resizing during the search in most cases.
+        reason_offsets_.reserve(num_related_vars_);
+        reason_arena_.reserve(num_related_vars_ * 16);
 
         for (Glucose::Var var : related_vars) {
             solver.addWatch(Glucose::mkLit(var, false), this);
@@ -35,26 +84,42 @@ public:
     bool propagate(Glucose::Solver& solver, Glucose::Lit p) override final {
         solver.registerUndo(var(p), this);
         static_cast<T*>(this)->SimplePropagatorDecide(p);
+        reason_offsets_.push_back(reason_arena_.size());
 
         if (num_pending_propagation() > 0) {
-            reasons_.push_back({});
             return true;
         }
 
-        auto res = static_cast<T*>(this)->DetectInconsistency();
-        if (res.has_value()) {
-            reasons_.push_back(*res);
+        if (budget_ != nullptr && budget_->IsExceeded(solver)) {
+            // The search stops at the next budget check of the solver. The interrupt is repeated every time since the
+            // caller may clear it.
+            budget_exceeded_ = true;
+            solver.interrupt();
+        }
+        if (progress_ != nullptr) {
+            progress_->OnSearch(solver);
+        }
+
+        solver_ = &solver;
+        const std::vector<Glucose::Lit>* res = RunCheapTier();
+        if (res == nullptr && num_pending_propagation() == 0 && ShouldRunExpensiveTier()) {
+            res = RunExpensiveTier();
+        }
+        solver_ = nullptr;
+        if (res != nullptr) {
+            conflict_reason_ = {(int)reason_arena_.size(), (int)(reason_arena_.size() + res->size())};
+            reason_arena_.insert(reason_arena_.end(), res->begin(), res->end());
             return false;
         } else {
-            reasons_.push_back({});
             return true;
         }
     }
 
     void calcReason(Glucose::Solver& solver, Glucose::Lit p, Glucose::Lit extra, Glucose::vec<Glucose::Lit>& out_reason) override final {
-        assert(!reasons_.back().empty());
-        for (auto& lit : reasons_.back()) {
-            out_reason.push(lit);
+        auto [begin, end] = p != Glucose::lit_Undef ? implication_reasons_[Glucose::var(p)] : conflict_reason_;
+        assert(begin <= end && end <= (int)reason_arena_.size());
+        for (int i = begin; i < end; ++i) {
+            out_reason.push(reason_arena_[i]);
         }
         if (extra != Glucose::lit_Undef) {
             out_reason.push(extra);
@@ -63,9 +128,19 @@ public:
 
     void undo(Glucose::Solver& solver, Glucose::Lit p) override final {
         static_cast<T*>(this)->SimplePropagatorUndo(p);
-        reasons_.pop_back();
+        reason_arena_.resize(reason_offsets_.back());
+        reason_offsets_.pop_back();
     }
 
+    void SetExpensiveTierSchedule(ExpensiveTierSchedule schedule) { schedule_ = schedule; }
+
+    // Makes the solver interrupted when `budget` is exceeded. After that, the expensive tier is skipped until all
+    // related variables are decided, so that the solver can stop quickly. `budget` must outlive the solver.
+    void SetBudget(const BudgetTracker* budget) { budget_ = budget; }
+    // Reports the search counters of the solver to `progress` at fixpoints. `progress` must outlive the solver.
+    void SetProgress(ProgressReporter* progress) { progress_ = progress; }
+    const SimplePropagatorStats& stats() const { return stats_; }
+
     // Subclasses should implement the following functions:
 
     // Returns all variables related to this constraint.
@@ -78,12 +153,135 @@ public:
     // called in the FIFO manner: the argument `p` to `Undo` is always the last literal among `Decide`d and undone ones.
     // void SimplePropagatorUndo(Glucose::Lit p);
 
-    // Determines whether inconsistency can be found under current decisions. If no inconsistency is found, std::nullopt
-    // is returned. If an inconsistenty is found, the "reason" is returned. A reason is a collection of literals
-    // all of which cannot be true at the same time for this constraint to be satisfied.
-    // std::optional<std::vector<Glucose::Lit>> DetectInconsistency();
+    // Determines whether inconsistency can be found under current decisions. If no inconsistency is found, nullptr is
+    // returned. If an inconsistenty is found, the "reason" is returned. A reason is a collection of literals all of
+    // which cannot be true at the same time for this constraint to be satisfied. The reason is owned by the subclass
+    // (typically a member reused across calls, so that no allocation is needed) and needs to be valid only until the
+    // function returns to `propagate`.
+    // const std::vector<Glucose::Lit>* DetectInconsistency();
+
+    // Optionally, subclasses can move costly rules to the expensive tier. It is run right after `DetectInconsistency`
+    // in the same `propagate` call, only if `DetectInconsistency` found nothing and no propagation is pending
+    // (including the literals enqueued by `DetectInconsistency`), so the internal state computed by
+    // `DetectInconsistency` can be reused. The return value is the same as `DetectInconsistency`. Depending on
+    // `ExpensiveTierSchedule`, some fixpoints may be skipped, but the tier is always run once all related variables
+    // are decided.
+    // const std::vector<Glucose::Lit>* DetectInconsistencyExpensive();
+
+protected:
+    // Enqueues the literal `lit` implied by `reason` (a collection of literals which are currently true). This can be
+    // called only from `DetectInconsistency` (or `DetectInconsistencyExpensive`). Returns false if `lit` is already
+    // false; in this case `reason` and `~lit` form an inconsistency, which the caller should return.
+    bool Imply(Glucose::Lit lit, const std::vector<Glucose::Lit>& reason) {
+        assert(solver_ != nullptr);
+        if (solver_->value(lit) == l_True) {
+            return true;
+        }
+        if (solver_->value(lit) == l_False) {
+            return false;
+        }
+        Glucose::Var v = Glucose::var(lit);
+        if (v >= (int)implication_reasons_.size()) {
+            implication_reasons_.resize(v + 1, {0, 0});
+        }
+        implication_reasons_[v] = {(int)reason_arena_.size(), (int)(reason_arena_.size() + reason.size())};
+        reason_arena_.insert(reason_arena_.end(), reason.begin(), reason.end());
+        if (in_expensive_tier_) {
+            ++stats_.expensive_implications;
+        } else {
+            ++stats_.cheap_implications;
+        }
+        return solver_->enqueue(lit, this);
+    }
 
 private:
-    std::vector<std::vector<Glucose::Lit>> reasons_;
+    template <typename U>
+    static constexpr auto HasExpensiveTier(int) -> decltype(std::declval<U&>().DetectInconsistencyExpensive(), true) {
+        return true;
+    }
+    template <typename U>
+    static constexpr bool HasExpensiveTier(...) {
+        return false;
+    }
+
+    const std::vector<Glucose::Lit>* RunCheapTier() {
+        ++stats_.cheap_runs;
+        const std::vector<Glucose::Lit>* res = static_cast<T*>(this)->DetectInconsistency();
+        if (res != nullptr) {
+            ++stats_.cheap_conflicts;
+        }
+        return res;
+    }
+
+    bool ShouldRunExpensiveTier() {
+        if constexpr (!HasExpensiveTier<T>(0)) {
+            return false;
+        }
+        // `reason_offsets_` has an entry for each decided related variable
+        if (reason_offsets_.size() >= num_related_vars_) {
+            return true;
+        }
+        if (budget_exceeded_) {
+            return false;
+        }
+        if (schedule_ == ExpensiveTierSchedule::kAtFixpoint) {
+            return true;
+        }
+        if (++fixpoints_since_expensive_ < expensive_interval_) {
+            ++stats_.expensive_skipped;
+            return false;
+        }
+        return true;
+    }
+
+    const std::vector<Glucose::Lit>* RunExpensiveTier() {
+        if constexpr (HasExpensiveTier<T>(0)) {
+            ++stats_.expensive_runs;
+            uint64_t implications_before = stats_.expensive_implications;
+            in_expensive_tier_ = true;
+            const std::vector<Glucose::Lit>* res = static_cast<T*>(this)->DetectInconsistencyExpensive();
+            in_expensive_tier_ = false;
+            if (res != nullptr) {
+                ++stats_.expensive_conflicts;
+            }
+
+            fixpoints_since_expensive_ = 0;
+            if (res != nullptr || stats_.expensive_implications != implications_before) {
+                expensive_interval_ = 1;
+            } else {
+                expensive_interval_ = std::min(expensive_interval_ * 2, kMaxExpensiveInterval);
+            }
+            return res;
+        } else {
+            return nullptr;
+        }
+    }
+
+    static constexpr int kMaxExpensiveInterval = 64;
+
+    // Reasons are stored contiguously in `reason_arena_`. Each `propagate` call owns the part of the arena beginning at
+    // its entry of `reason_offsets_`, which is released by `undo`. The literals implied in a call are unassigned before
+    // the literal of the call, so their reasons can be stored in that part as well.
+    std::vector<Glucose::Lit> reason_arena_;
+    std::vector<int> reason_offsets_;
+
+    // Ranges [begin, end) in `reason_arena_` of the reasons of the literals enqueued by `Imply`, indexed by variables.
+    // An entry may be stale after the literal is unassigned, but it is overwritten when the variable is implied again.
+    std::vector<std::pair<int, int>> implication_reasons_;
+    // Range of the reason of the inconsistency found by the last `propagate` call
+    std::pair<int, int> conflict_reason_ = {0, 0};
+    Glucose::Solver* solver_ = nullptr;
+
+    size_t num_related_vars_ = 0;
+    ExpensiveTierSchedule schedule_ = ExpensiveTierSchedule::kAtFixpoint;
+    // With `ExpensiveTierSchedule::kAdaptive`, the expensive tier is run at one in `expensive_interval_` fixpoints
+    int expensive_interval_ = 1;
+    int fixpoints_since_expensive_ = 0;
+    bool in_expensive_tier_ = false;
+    SimplePropagatorStats stats_;
+
+    const BudgetTracker* budget_ = nullptr;
+    bool budget_exceeded_ = false;
+    ProgressReporter* progress_ = nullptr;
 
 };
@@ -1,55 +1,24 @@
 #include "doublechoco/Balancer.h"
 
 #include <algorithm>
-#include <set>
-
-#include "Grid.h"
+#include <cassert>
+#include <functional>
 
 namespace doublechoco {
 
-namespace {
-
-class WeightedUnionFind {
-public:
-    WeightedUnionFind(const std::vector<int>& weight) : parent_(weight.size(), -1), weight_(weight) {}
-
-    int Root(int p) {
-        if (parent_[p] < 0) {
-            return p;
-        } else {
-            return parent_[p] = Root(parent_[p]);
-        }
-    }
-
-    bool Union(int p, int q) {
-        p = Root(p);
-        q = Root(q);
-
-        if (p == q) {
-            return false;
-        }
-
-        if (parent_[p] > parent_[q])
-            std::swap(p, q);
-        parent_[p] += parent_[q];
-        parent_[q] = p;
-        weight_[p] += weight_[q];
-        return true;
-    }
-
-    int Weight(int p) { return weight_[Root(p)]; }
-
-private:
-    std::vector<int> parent_, weight_;
-};
-
-} // namespace
-
 Balancer::Balancer(const Problem& problem, Glucose::Var origin)
     : problem_(problem), origin_(origin), adj_edges_(problem.height() * problem.width()),
       edge_deactivated_(problem.height() * (problem.width() - 1) + (problem.height() - 1) * problem.width(), 0),
       color_(problem.height() * problem.width()), rank_(problem.height() * problem.width()),
-      lowlink_(problem.height() * problem.width()), subtree_sum_(problem.height() * problem.width()) {
+      lowlink_(problem.height() * problem.width()), subtree_sum_(problem.height() * problem.width()),
+      parent_edge_(problem.height() * problem.width()),
+      decision_index_(problem.height() * (problem.width() - 1) + (problem.height() - 1) * problem.width(), 0),
+      dirty_seen_(problem.height() * problem.width(), 0),
+      implied_at_(problem.height() * (problem.width() - 1) + (problem.height() - 1) * problem.width(), 0),
+      conflict_root_(0), visited_(problem.height() * problem.width(), 0), visit_epoch_(0),
+      uf_parent_(problem.height() * problem.width()), uf_weight_(problem.height() * problem.width()),
+      edge_mark_(problem.height() * (problem.width() - 1) + (problem.height() - 1) * problem.width(), 0),
+      edge_mark_epoch_(0), reason_cell_mark_(problem.height() * problem.width(), 0), reason_cell_mark_epoch_(0) {
     int height = problem.height();
     int width = problem.width();
 
@@ -73,16 +42,32 @@ Balancer::Balancer(const Problem& problem, Glucose::Var origin)
             color_[y * width + x] = problem_.color(y, x) * 2 - 1;
         }
     }
+
+    // Reserve the work areas for their maximum sizes, so that nothing is allocated during the search. `dirty_cells_`
+    // never grows beyond its capacity (see `MarkDirty`). The number of analyses at each decision is not bounded as
+    // such, but there are much fewer than `analysis_history_` is reserved for in practice.
+    int num_cells = height * width;
+    decision_order_.reserve(edges_.size());
+    analysis_history_.reserve(edges_.size() + num_cells);
+    dirty_cells_.reserve(num_cells * 2);
+    block_cells_.reserve(num_cells);
+    dfs_stack_.reserve(num_cells);
+    reason_cells_.reserve(num_cells);
+    reason_walls_.reserve(edges_.size());
+
+    // Nothing is analyzed yet
+    for (int i = 0; i < num_cells; ++i) {
+        MarkDirty(i);
+    }
 }
 
 bool Balancer::initialize(Glucose::Solver& solver) {
-    std::vector<Glucose::Var> related_vars;
-    for (int i = 0; i < adj_edges_.size(); ++i) {
+    for (int i = 0; i < edges_.size(); ++i) {
         Glucose::Var var = origin_ + i;
         solver.addWatch(Glucose::mkLit(var, false), this);
     }
 
-    for (int i = 0; i < adj_edges_.size(); ++i) {
+    for (int i = 0; i < edges_.size(); ++i) {
         Glucose::Var var = origin_ + i;
         Glucose::lbool val = solver.value(var);
         if (val == l_True) {
@@ -99,193 +84,246 @@ bool Balancer::propagate(Glucose::Solver& solver, Glucose::Lit p) {
     solver.registerUndo(var(p), this);
     assert(!Glucose::sign(p));
     int edge_id = Glucose::var(p) - origin_;
+    decision_index_[edge_id] = decision_order_.size();
     decision_order_.push_back(edge_id);
     assert(edge_deactivated_[edge_id] == 0);
     edge_deactivated_[edge_id] = 1;
 
+    // Only the potential block which contained this edge is changed
+    MarkDirty(edges_[edge_id].first);
+    MarkDirty(edges_[edge_id].second);
+
     if (num_pending_propagation() > 0) {
         // lazy propagation
         return true;
     }
 
-    std::fill(rank_.begin(), rank_.end(), -1);
-    next_rank_ = 0;
-    for (int v = 0; v < rank_.size(); ++v) {
-        if (rank_[v] != -1) {
+    ++visit_epoch_;
+    if (visit_epoch_ == 0) {
+        std::fill(visited_.begin(), visited_.end(), 0);
+        visit_epoch_ = 1;
+    }
+    while (!dirty_cells_.empty()) {
+        int v = dirty_cells_.back();
+        dirty_cells_.pop_back();
+        if (visited_[v] == visit_epoch_) {
             continue;
         }
-        traverse(v, -1);
-        if (subtree_sum_[v] != 0) {
-            // the connected component containing `i` is not balanced
+        analysis_history_.push_back({(int)decision_order_.size(), v});
+        if (!AnalyzeBlock(solver, v)) {
             return false;
         }
     }
 
-    for (int i = 0; i < edges_.size(); ++i) {
-        if (edge_deactivated_[i]) {
-            continue;
-        }
-        auto [u, v] = edges_[i];
-        if (rank_[u] > rank_[v]) {
-            std::swap(u, v);
-        }
-        if (lowlink_[v] > rank_[u]) {
-            // v is separated from u after removal of edge (u, v)
-            if (subtree_sum_[v] != 0) {
-                // removing (u, v) makes the graph imbalance
-                if (!solver.enqueue(Glucose::mkLit(origin_ + i, true), this)) {
-                    return false;
-                }
+    return true;
+}
+
+bool Balancer::AnalyzeBlock(Glucose::Solver& solver, int root) {
+    // Tarjan's lowlink, with an explicit stack of (vertex, index of the next edge in `adj_edges_`)
+    int next_rank = 0;
+    block_cells_.clear();
+    dfs_stack_.clear();
+
+    auto visit = [&](int v, int parent_edge) {
+        visited_[v] = visit_epoch_;
+        rank_[v] = lowlink_[v] = next_rank++;
+        subtree_sum_[v] = color_[v];
+        parent_edge_[v] = parent_edge;
+        block_cells_.push_back(v);
+        dfs_stack_.push_back({v, 0});
+    };
+
+    visit(root, -1);
+    while (!dfs_stack_.empty()) {
+        int u = dfs_stack_.back().first;
+        int idx = dfs_stack_.back().second;
+
+        if (idx < adj_edges_[u].size()) {
+            ++dfs_stack_.back().second;
+            auto [edge_id, v] = adj_edges_[u][idx];
+            if (edge_deactivated_[edge_id] || edge_id == parent_edge_[u]) {
+                continue;
+            }
+            if (visited_[v] != visit_epoch_) {
+                visit(v, edge_id);
+            } else {
+                lowlink_[u] = std::min(lowlink_[u], rank_[v]);
+            }
+        } else {
+            dfs_stack_.pop_back();
+            if (parent_edge_[u] != -1) {
+                auto [a, b] = edges_[parent_edge_[u]];
+                int parent = a ^ b ^ u;
+                subtree_sum_[parent] += subtree_sum_[u];
+                lowlink_[parent] = std::min(lowlink_[parent], lowlink_[u]);
             }
         }
     }
 
-    return true;
-}
+    if (subtree_sum_[root] != 0) {
+        // the potential block containing `root` is not balanced
+        conflict_root_ = root;
+        return false;
+    }
 
-void Balancer::traverse(int u, int parent) {
-    rank_[u] = next_rank_++;
-    lowlink_[u] = rank_[u];
-    subtree_sum_[u] = color_[u];
-    for (auto [edge_id, v] : adj_edges_[u]) {
-        if (edge_deactivated_[edge_id]) {
-            continue;
-        }
-        if (v == parent) {
+    for (int v : block_cells_) {
+        int edge_id = parent_edge_[v];
+        if (edge_id == -1) {
             continue;
         }
-        if (rank_[v] == -1) {
-            traverse(v, u);
-            subtree_sum_[u] += subtree_sum_[v];
-            lowlink_[u] = std::min(lowlink_[u], lowlink_[v]);
-        } else {
-            lowlink_[u] = std::min(lowlink_[u], rank_[v]);
+        auto [a, b] = edges_[edge_id];
+        int u = a ^ b ^ v;
+        if (lowlink_[v] > rank_[u] && subtree_sum_[v] != 0) {
+            // v is separated from u after removal of edge (u, v), which makes the graph imbalance
+            Glucose::Lit lit = Glucose::mkLit(origin_ + edge_id, true);
+            if (solver.value(lit) == l_Undef) {
+                implied_at_[edge_id] = decision_order_.size();
+            }
+            if (!solver.enqueue(lit, this)) {
+                conflict_root_ = root;
+                return false;
+            }
         }
     }
+
+    return true;
 }
 
 void Balancer::calcReason(Glucose::Solver& solver, Glucose::Lit p, Glucose::Lit extra,
                           Glucose::vec<Glucose::Lit>& out_reason) {
+    int num_decisions = decision_order_.size();
+    int hypothetical_edge = -1;
+    int extra_edge = -1;
+    int root = conflict_root_;
     if (p != Glucose::lit_Undef) {
         assert(Glucose::sign(p));
-        int edge_id = Glucose::var(p) - origin_;
-        assert(!edge_deactivated_[edge_id]);
-        edge_deactivated_[edge_id] = 1;
+        hypothetical_edge = Glucose::var(p) - origin_;
+        assert(!edge_deactivated_[hypothetical_edge]);
+        // Only walls decided before `p` is implied can be a reason of `p`
+        num_decisions = implied_at_[hypothetical_edge];
+        root = edges_[hypothetical_edge].first;
     }
     if (extra != Glucose::lit_Undef) {
         assert(!Glucose::sign(extra));
-        int edge_id = Glucose::var(extra) - origin_;
-        assert(!edge_deactivated_[edge_id]);
-        edge_deactivated_[edge_id] = 1;
-        decision_order_.push_back(edge_id);
+        extra_edge = Glucose::var(extra) - origin_;
+        assert(!edge_deactivated_[extra_edge]);
     }
 
-    std::vector<Glucose::Lit> reason = CalcReasonImpl();
-    for (auto l : reason) {
-        out_reason.push(l);
-    }
+    CalcReasonImpl(root, num_decisions, hypothetical_edge, extra_edge, out_reason);
+}
 
-    if (p != Glucose::lit_Undef) {
-        int edge_id = Glucose::var(p) - origin_;
-        edge_deactivated_[edge_id] = 0;
-    }
-    if (extra != Glucose::lit_Undef) {
-        int edge_id = Glucose::var(extra) - origin_;
-        edge_deactivated_[edge_id] = 0;
-        decision_order_.pop_back();
+int Balancer::UnionFindRoot(int p) {
+    while (uf_parent_[p] >= 0) {
+        if (uf_parent_[uf_parent_[p]] >= 0) {
+            uf_parent_[p] = uf_parent_[uf_parent_[p]];
+        }
+        p = uf_parent_[p];
     }
+    return p;
 }
 
-namespace {
-
-int dfs(const Problem& problem, Grid<bool>& visited, const std::set<int>& del_edge, int y, int x) {
-    if (visited.at(y, x))
-        return 0;
-    visited.at(y, x) = true;
-    int ret = problem.color(y, x) * 2 - 1;
-    if (y > 0 && del_edge.count(problem.height() * (problem.width() - 1) + (y - 1) * problem.width() + x) == 0) {
-        ret += dfs(problem, visited, del_edge, y - 1, x);
-    }
-    if (y < problem.height() - 1 &&
-        del_edge.count(problem.height() * (problem.width() - 1) + y * problem.width() + x) == 0) {
-        ret += dfs(problem, visited, del_edge, y + 1, x);
+void Balancer::CalcReasonImpl(int root, int num_decisions, int hypothetical_edge, int extra_edge,
+                              Glucose::vec<Glucose::Lit>& out_reason) {
+    ++reason_cell_mark_epoch_;
+    if (reason_cell_mark_epoch_ == 0) {
+        std::fill(reason_cell_mark_.begin(), reason_cell_mark_.end(), 0);
+        reason_cell_mark_epoch_ = 1;
     }
-    if (x > 0 && del_edge.count(y * (problem.width() - 1) + x - 1) == 0) {
-        ret += dfs(problem, visited, del_edge, y, x - 1);
+    ++edge_mark_epoch_;
+    if (edge_mark_epoch_ == 0) {
+        std::fill(edge_mark_.begin(), edge_mark_.end(), 0);
+        edge_mark_epoch_ = 1;
     }
-    if (x < problem.width() - 1 && del_edge.count(y * (problem.width() - 1) + x) == 0) {
-        ret += dfs(problem, visited, del_edge, y, x + 1);
-    }
-    return ret;
-}
 
-void is_disconnected(const Problem& problem, std::vector<Glucose::Lit> reason, Glucose::Var origin) {
-    std::set<int> del_edge;
-    for (auto& l : reason) {
-        del_edge.insert(Glucose::var(l) - origin);
-    }
-    Grid<bool> visited(problem.height(), problem.width(), false);
-    for (int y = 0; y < problem.height(); ++y) {
-        for (int x = 0; x < problem.width(); ++x) {
-            if (visited.at(y, x))
+    auto is_wall = [&](int edge_id) {
+        return edge_deactivated_[edge_id] && decision_index_[edge_id] < num_decisions;
+    };
+
+    // The potential block containing `root` when the first `num_decisions` walls are decided
+    reason_cells_.clear();
+    reason_cells_.push_back(root);
+    reason_cell_mark_[root] = reason_cell_mark_epoch_;
+    for (int i = 0; i < reason_cells_.size(); ++i) {
+        int u = reason_cells_[i];
+        uf_parent_[u] = -1;
+        uf_weight_[u] = color_[u];
+        for (auto [edge_id, v] : adj_edges_[u]) {
+            if (is_wall(edge_id)) {
                 continue;
-            if (dfs(problem, visited, del_edge, y, x) != 0)
-                return;
-        }
-    }
-    for (int y = 0; y < problem.height(); ++y) {
-        for (int x = 0; x < problem.width(); ++x) {
-            printf("%d ", problem.color(y, x));
+            }
+            if (reason_cell_mark_[v] != reason_cell_mark_epoch_) {
+                reason_cell_mark_[v] = reason_cell_mark_epoch_;
+                reason_cells_.push_back(v);
+            }
         }
-        puts("");
-        puts("");
     }
-    for (auto e : del_edge)
-        printf("%d ", e);
-    puts("");
-    assert(false);
-}
-
-} // namespace
-
-std::vector<Glucose::Lit> Balancer::CalcReasonImpl() {
-    WeightedUnionFind uf(color_);
 
-    for (int i = 0; i < edges_.size(); ++i) {
-        if (!edge_deactivated_[i]) {
-            uf.Union(edges_[i].first, edges_[i].second);
+    // Returns the new root, or -1 if `p` and `q` are already in the same group
+    auto unite = [&](int p, int q) {
+        p = UnionFindRoot(p);
+        q = UnionFindRoot(q);
+        if (p == q) {
+            return -1;
+        }
+        if (uf_parent_[p] > uf_parent_[q]) {
+            std::swap(p, q);
+        }
+        uf_parent_[p] += uf_parent_[q];
+        uf_parent_[q] = p;
+        uf_weight_[p] += uf_weight_[q];
+        return p;
+    };
+
+    // The walls on the boundary separate the block from the rest of the board, so they are always in the reason.
+    // The walls inside the block are added back below in the reverse order of decisions.
+    reason_walls_.clear();
+    for (int u : reason_cells_) {
+        for (auto [edge_id, v] : adj_edges_[u]) {
+            if (edge_mark_[edge_id] == edge_mark_epoch_) {
+                continue;
+            }
+            edge_mark_[edge_id] = edge_mark_epoch_;
+            if (reason_cell_mark_[v] != reason_cell_mark_epoch_) {
+                out_reason.push(Glucose::mkLit(origin_ + edge_id, false));
+            } else if (edge_id == extra_edge) {
+                reason_walls_.push_back({num_decisions, edge_id});
+            } else if (is_wall(edge_id)) {
+                reason_walls_.push_back({decision_index_[edge_id], edge_id});
+            } else if (edge_id != hypothetical_edge) {
+                unite(u, v);
+            }
         }
     }
+    std::sort(reason_walls_.begin(), reason_walls_.end(), std::greater<std::pair<int, int>>());
 
     int n_imbalance = 0;
-    for (int i = 0; i < color_.size(); ++i) {
-        if (uf.Root(i) == i && uf.Weight(i) != 0) {
+    for (int v : reason_cells_) {
+        if (uf_parent_[v] < 0 && uf_weight_[v] != 0) {
             ++n_imbalance;
         }
     }
 
     assert(n_imbalance > 0);
 
-    std::vector<Glucose::Lit> ret;
-    for (int i = decision_order_.size() - 1; i >= 0; --i) {
-        auto [u, v] = edges_[decision_order_[i]];
+    for (auto& wall : reason_walls_) {
+        int edge_id = wall.second;
+        auto [u, v] = edges_[edge_id];
 
-        u = uf.Root(u);
-        v = uf.Root(v);
+        u = UnionFindRoot(u);
+        v = UnionFindRoot(v);
         if (u == v) {
             continue;
         }
 
-        int weight_u = uf.Weight(u), weight_v = uf.Weight(v);
+        int weight_u = uf_weight_[u], weight_v = uf_weight_[v];
         if (weight_u != 0 && weight_u + weight_v == 0 && n_imbalance == 2) {
             // keep this edge
-            ret.push_back(Glucose::mkLit(origin_ + decision_order_[i], false));
+            out_reason.push(Glucose::mkLit(origin_ + edge_id, false));
         } else {
-            uf.Union(u, v);
+            unite(u, v);
             n_imbalance += (weight_u == 0 ? 0 : -1) + (weight_v == 0 ? 0 : -1) + ((weight_u + weight_v) == 0 ? 0 : 1);
         }
     }
-    return ret;
 }
 
 void Balancer::undo(Glucose::Solver& solver, Glucose::Lit p) {
@@ -294,7 +332,36 @@ void Balancer::undo(Glucose::Solver& solver, Glucose::Lit p) {
     int e = decision_order_.back();
     assert(edge_deactivated_[e] == 1);
     edge_deactivated_[e] = 0;
+
+    // Implications made by analyses after this wall are undone together with it
+    while (!analysis_history_.empty() && analysis_history_.back().first == decision_order_.size()) {
+        MarkDirty(analysis_history_.back().second);
+        analysis_history_.pop_back();
+    }
     decision_order_.pop_back();
+
+    // The blocks on both sides of the edge are merged
+    MarkDirty(edges_[e].first);
+}
+
+void Balancer::MarkDirty(int cell) {
+    if (dirty_cells_.size() == dirty_cells_.capacity()) {
+        // Keep the last occurrence of each cell, preserving the order
+        int n = dirty_cells_.size();
+        int m = n;
+        for (int i = n - 1; i >= 0; --i) {
+            int v = dirty_cells_[i];
+            if (!dirty_seen_[v]) {
+                dirty_seen_[v] = 1;
+                dirty_cells_[--m] = v;
+            }
+        }
+        dirty_cells_.erase(dirty_cells_.begin(), dirty_cells_.begin() + m);
+        for (int v : dirty_cells_) {
+            dirty_seen_[v] = 0;
+        }
+    }
+    dirty_cells_.push_back(cell);
 }
 
 }
@@ -10,6 +10,9 @@
 namespace doublechoco {
 
 // Ensure that all potential block have the equal number of black and white cells
+//
+// Bridges and subtree sums are computed per potential block, and only blocks changed by a new wall (or by an undo
+// since their last analysis) are analyzed again.
 class Balancer : public Glucose::Constraint {
 public:
     Balancer(const Problem& problem, Glucose::Var origin);
@@ -22,9 +25,21 @@ public:
     void undo(Glucose::Solver& solver, Glucose::Lit p) override;
 
 private:
-    void traverse(int u, int parent);
+    // Analyzes the potential block containing `root` and enqueues the bridges which must be kept.
+    // Returns false if an inconsistency is found.
+    bool AnalyzeBlock(Glucose::Solver& solver, int root);
 
-    std::vector<Glucose::Lit> CalcReasonImpl();
+    // Adds `cell` to `dirty_cells_`. When it is full, the earlier occurrences of duplicated cells are removed first;
+    // they would be skipped anyway since the last one is analyzed first.
+    void MarkDirty(int cell);
+
+    // Appends to `out_reason` a set of walls among the first `num_decisions` decided walls (and `extra_edge`, if not
+    // -1) which makes some potential block imbalanced when `hypothetical_edge` (if not -1) is also a wall. Only the
+    // potential block containing `root` (under the first `num_decisions` walls) is looked at, since it is the one
+    // which became imbalanced; its boundary walls are always included.
+    void CalcReasonImpl(int root, int num_decisions, int hypothetical_edge, int extra_edge,
+                        Glucose::vec<Glucose::Lit>& out_reason);
+    int UnionFindRoot(int p);
 
     Problem problem_;
     Glucose::Var origin_;
@@ -32,9 +47,35 @@ private:
     std::vector<std::pair<int, int>> edges_;
     std::vector<int> edge_deactivated_;
     std::vector<int> color_;
-    std::vector<int> rank_, lowlink_, subtree_sum_;
+    std::vector<int> rank_, lowlink_, subtree_sum_, parent_edge_;
     std::vector<int> decision_order_;
-    int next_rank_;
+    // Index in `decision_order_` of each deactivated edge
+    std::vector<int> decision_index_;
+
+    // Cells whose potential blocks need to be analyzed
+    std::vector<int> dirty_cells_;
+    std::vector<int> dirty_seen_; // work area for `MarkDirty`, all 0 outside of it
+    // (number of decided walls, a cell) for each analysis, so that the block is analyzed again when the implications
+    // made by the analysis are undone
+    std::vector<std::pair<int, int>> analysis_history_;
+    // Number of decided walls when each edge was implied to be connected
+    std::vector<int> implied_at_;
+    // A cell of the potential block in which the last inconsistency was found
+    int conflict_root_;
+
+    // Work area
+    std::vector<unsigned int> visited_;
+    unsigned int visit_epoch_;
+    std::vector<int> block_cells_;
+    std::vector<std::pair<int, int>> dfs_stack_;
+    std::vector<int> uf_parent_, uf_weight_;
+    std::vector<unsigned int> edge_mark_;
+    unsigned int edge_mark_epoch_;
+    // Work area for `CalcReasonImpl`, separate from the one for `AnalyzeBlock`
+    std::vector<unsigned int> reason_cell_mark_;
+    unsigned int reason_cell_mark_epoch_;
+    std::vector<int> reason_cells_;
+    std::vector<std::pair<int, int>> reason_walls_; // (index in `decision_order_`, edge) of walls inside the block
 };
 
 }
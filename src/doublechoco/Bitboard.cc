@@ -0,0 +1,162 @@
+#include "doublechoco/Bitboard.h"
+
+#include <cassert>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace doublechoco {
+
+namespace {
+
+// Expands the set of cells `g` in a row along passable borders. Bit x of `pass` means that the border between x and
+// x + 1 is passable. Kogge-Stone style doubling is used so that a whole row is processed in O(log 64) steps.
+inline uint64_t FillRow(uint64_t g, uint64_t pass) {
+    // rightward: cell x can be entered from x - 1
+    uint64_t p = pass << 1;
+    g |= p & (g << 1);
+    p &= p << 1;
+    g |= p & (g << 2);
+    p &= p << 2;
+    g |= p & (g << 4);
+    p &= p << 4;
+    g |= p & (g << 8);
+    p &= p << 8;
+    g |= p & (g << 16);
+    p &= p << 16;
+    g |= p & (g << 32);
+
+    // leftward: cell x can be entered from x + 1
+    p = pass;
+    g |= p & (g >> 1);
+    p &= p >> 1;
+    g |= p & (g >> 2);
+    p &= p >> 2;
+    g |= p & (g >> 4);
+    p &= p >> 4;
+    g |= p & (g >> 8);
+    p &= p >> 8;
+    g |= p & (g >> 16);
+    p &= p >> 16;
+    g |= p & (g >> 32);
+
+    return g;
+}
+
+#ifdef __AVX2__
+
+template <int S> inline void FillStepRight(__m256i& g, __m256i& p) {
+    g = _mm256_or_si256(g, _mm256_and_si256(p, _mm256_slli_epi64(g, S)));
+    p = _mm256_and_si256(p, _mm256_slli_epi64(p, S));
+}
+
+template <int S> inline void FillStepLeft(__m256i& g, __m256i& p) {
+    g = _mm256_or_si256(g, _mm256_and_si256(p, _mm256_srli_epi64(g, S)));
+    p = _mm256_and_si256(p, _mm256_srli_epi64(p, S));
+}
+
+#endif
+
+// Applies `FillRow` to each of the `n` rows. Returns whether any row is changed.
+bool FillRows(uint64_t* g, const uint64_t* pass, int n) {
+    int i = 0;
+    uint64_t diff = 0;
+
+#ifdef __AVX2__
+    // 4 rows at once
+    __m256i diff_vec = _mm256_setzero_si256();
+    for (; i + 4 <= n; i += 4) {
+        __m256i orig = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(g + i));
+        __m256i pass_vec = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pass + i));
+        __m256i v = orig;
+
+        __m256i p = _mm256_slli_epi64(pass_vec, 1);
+        FillStepRight<1>(v, p);
+        FillStepRight<2>(v, p);
+        FillStepRight<4>(v, p);
+        FillStepRight<8>(v, p);
+        FillStepRight<16>(v, p);
+        FillStepRight<32>(v, p);
+
+        p = pass_vec;
+        FillStepLeft<1>(v, p);
+        FillStepLeft<2>(v, p);
+        FillStepLeft<4>(v, p);
+        FillStepLeft<8>(v, p);
+        FillStepLeft<16>(v, p);
+        FillStepLeft<32>(v, p);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(g + i), v);
+        diff_vec = _mm256_or_si256(diff_vec, _mm256_xor_si256(v, orig));
+    }
+    if (!_mm256_testz_si256(diff_vec, diff_vec)) {
+        diff = 1;
+    }
+#endif
+
+    for (; i < n; ++i) {
+        uint64_t v = FillRow(g[i], pass[i]);
+        diff |= v ^ g[i];
+        g[i] = v;
+    }
+    return diff != 0;
+}
+
+} // namespace
+
+Bitboard::Bitboard(const Problem& problem)
+    : height_(problem.height()), width_(problem.width()), horizontal_wall_(problem.height(), 0),
+      vertical_wall_(problem.height(), 0), horizontal_same_color_(problem.height(), 0), vertical_same_color_(problem.height(), 0),
+      horizontal_passable_(problem.height(), 0), vertical_passable_(problem.height(), 0) {
+    assert(width_ <= kMaxWidth);
+
+    for (int y = 0; y < height_; ++y) {
+        for (int x = 0; x < width_; ++x) {
+            if (x < width_ - 1 && problem.color(y, x) == problem.color(y, x + 1)) {
+                horizontal_same_color_[y] |= 1ULL << x;
+            }
+            if (y < height_ - 1 && problem.color(y, x) == problem.color(y + 1, x)) {
+                vertical_same_color_[y] |= 1ULL << x;
+            }
+        }
+    }
+}
+
+void Bitboard::FloodPotentialUnit(int y, int x, std::vector<uint64_t>& out) const {
+    out.assign(height_, 0);
+    for (int i = 0; i < height_; ++i) {
+        horizontal_passable_[i] = horizontal_same_color_[i] & ~horizontal_wall_[i];
+        vertical_passable_[i] = vertical_same_color_[i] & ~vertical_wall_[i];
+    }
+
+    out[y] = FillRow(1ULL << x, horizontal_passable_[y]);
+
+    // Alternate vertical sweeps (which are inherently sequential) and horizontal expansion of all rows (which is
+    // row-parallel) until nothing changes.
+    for (;;) {
+        bool changed = false;
+        for (int i = 1; i < height_; ++i) {
+            uint64_t add = out[i - 1] & vertical_passable_[i - 1] & ~out[i];
+            if (add != 0) {
+                out[i] |= add;
+                changed = true;
+            }
+        }
+        for (int i = height_ - 2; i >= 0; --i) {
+            uint64_t add = out[i + 1] & vertical_passable_[i] & ~out[i];
+            if (add != 0) {
+                out[i] |= add;
+                changed = true;
+            }
+        }
+        if (!changed) {
+            break;
+        }
+        if (!FillRows(out.data(), horizontal_passable_.data(), height_)) {
+            break;
+        }
+    }
+}
+
+}
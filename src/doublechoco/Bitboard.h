@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "doublechoco/Problem.h"
+
+namespace doublechoco {
+
+// Bit-packed representation of the walls of a board whose width is at most `kMaxWidth`.
+// Each row is represented by 64-bit masks. Bit x of a row mask corresponds to the horizontal border between (y, x) and
+// (y, x + 1) (`horizontal_*`), or to the vertical border between (y, x) and (y + 1, x) (`vertical_*`). Connected
+// borders are not stored, since they are tracked by the union-finds of `BoardManager`.
+class Bitboard {
+public:
+    static constexpr int kMaxWidth = 64;
+
+    Bitboard(const Problem& problem);
+
+    int height() const { return height_; }
+    int width() const { return width_; }
+
+    void SetHorizontalWall(int y, int x) { horizontal_wall_[y] |= 1ULL << x; }
+    void SetVerticalWall(int y, int x) { vertical_wall_[y] |= 1ULL << x; }
+    void ClearHorizontalWall(int y, int x) { horizontal_wall_[y] &= ~(1ULL << x); }
+    void ClearVerticalWall(int y, int x) { vertical_wall_[y] &= ~(1ULL << x); }
+
+    uint64_t horizontal_wall(int y) const { return horizontal_wall_[y]; }
+    uint64_t vertical_wall(int y) const { return vertical_wall_[y]; }
+    uint64_t horizontal_same_color(int y) const { return horizontal_same_color_[y]; }
+    uint64_t vertical_same_color(int y) const { return vertical_same_color_[y]; }
+
+    // Computes the potential unit containing (y, x), that is, the set of cells reachable from (y, x) without crossing
+    // walls or borders between differently colored cells. The result is stored in `out` (one mask per row).
+    void FloodPotentialUnit(int y, int x, std::vector<uint64_t>& out) const;
+
+private:
+    int height_, width_;
+    std::vector<uint64_t> horizontal_wall_, vertical_wall_;
+    std::vector<uint64_t> horizontal_same_color_, vertical_same_color_;
+
+    // Work area for `FloodPotentialUnit`
+    mutable std::vector<uint64_t> horizontal_passable_, vertical_passable_;
+};
+
+}
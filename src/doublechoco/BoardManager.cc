@@ -1,14 +1,101 @@
 #include "doublechoco/BoardManager.h"
 
+#include <algorithm>
 #include <cassert>
-#include <queue>
+#include <limits>
+
+#include "ConnectedComponents.h"
 
 namespace doublechoco {
 
+namespace {
+
+std::vector<int> CellColors(const Problem& problem) {
+    std::vector<int> ret;
+    for (int y = 0; y < problem.height(); ++y) {
+        for (int x = 0; x < problem.width(); ++x) {
+            ret.push_back(problem.color(y, x));
+        }
+    }
+    return ret;
+}
+
+// Cells of the same color are connected unless there is a wall between them.
+struct PotentialUnitPolicy {
+    const BoardManager& board;
+
+    bool Contains(int y, int x) const { return true; }
+    bool Passable(int y, int x, int y2, int x2) const {
+        if (board.problem().color(y, x) != board.problem().color(y2, x2)) {
+            return false;
+        }
+        if (y == y2) {
+            return board.horizontal(y, std::min(x, x2)) != BoardManager::Border::kWall;
+        } else {
+            return board.vertical(std::min(y, y2), x) != BoardManager::Border::kWall;
+        }
+    }
+};
+
+} // namespace
+
 BoardManager::BoardManager(const Problem& problem, Glucose::Var origin)
     : height_(problem.height()), width_(problem.width()), problem_(problem), origin_(origin),
       horizontal_(problem.height() * (problem.width() - 1), Border::kUndecided),
-      vertical_((problem.height() - 1) * problem.width(), Border::kUndecided) {}
+      vertical_((problem.height() - 1) * problem.width(), Border::kUndecided),
+      decision_index_(problem.height() * (problem.width() - 1) + (problem.height() - 1) * problem.width(), -1),
+      units_uf_(CellColors(problem)),
+      blocks_uf_(CellColors(problem)), potential_unit_id_(problem.height() * problem.width(), -1),
+      search_visited_(problem.height() * problem.width(), 0), search_epoch_(0),
+      reason_from_(problem.height() * problem.width()), reason_visited_(problem.height() * problem.width(), 0),
+      reason_used_(problem.height() * problem.width(), 0), reason_epoch_(0) {
+    if (width_ <= Bitboard::kMaxWidth) {
+        bitboard_.emplace(problem);
+    }
+
+    // Initially all borders are undecided, so potential units are connected components of cells of the same color.
+    Grid<int> group_id(height_, width_, -1);
+    std::vector<std::pair<int, int>> stack;
+    int num_groups = LabelConnectedComponents(PotentialUnitPolicy{*this}, group_id, stack);
+    potential_unit_size_.assign(num_groups, 0);
+    potential_unit_head_.assign(num_groups, -1);
+    potential_unit_next_.resize(height_ * width_);
+    potential_unit_prev_.resize(height_ * width_);
+    for (int y = 0; y < height_; ++y) {
+        for (int x = 0; x < width_; ++x) {
+            int cell = y * width_ + x;
+            int id = group_id.at(y, x);
+            potential_unit_id_[cell] = id;
+            ++potential_unit_size_[id];
+            // Insert `cell` after the head
+            int head = potential_unit_head_[id];
+            if (head == -1) {
+                potential_unit_head_[id] = cell;
+                potential_unit_next_[cell] = potential_unit_prev_[cell] = cell;
+            } else {
+                int next = potential_unit_next_[head];
+                potential_unit_next_[head] = cell;
+                potential_unit_prev_[cell] = head;
+                potential_unit_next_[cell] = next;
+                potential_unit_prev_[next] = cell;
+            }
+        }
+    }
+
+    // Reserve the work areas for their maximum sizes, so that nothing is allocated during the search. A cell is moved
+    // to a new potential unit by a split at most a few times in practice, which `split_cells_` is reserved for.
+    int num_cells = height_ * width_;
+    int num_borders = horizontal_.size() + vertical_.size();
+    decisions_.reserve(num_borders);
+    potential_unit_size_.reserve(num_cells);
+    potential_unit_head_.reserve(num_cells);
+    potential_unit_splits_.reserve(num_cells);
+    split_cells_.reserve(num_cells * 4);
+    search_queue_[0].reserve(num_cells);
+    search_queue_[1].reserve(num_cells);
+    reason_queue_.reserve(num_cells);
+    reason_found_.reserve(num_cells);
+}
 
 BoardManager::Border BoardManager::horizontal(int y, int x) const {
     assert(0 <= y && y < height_ && 0 <= x && x < width_ - 1);
@@ -37,14 +124,36 @@ void BoardManager::Decide(Glucose::Lit lit) {
     bool sign = Glucose::sign(lit);
     Border new_value = sign ? Border::kConnected : Border::kWall;
 
+    int cell_a, cell_b;
     if (ofs < height_ * (width_ - 1)) {
         assert(horizontal_[ofs] == Border::kUndecided);
         horizontal_[ofs] = new_value;
+        cell_a = ofs / (width_ - 1) * width_ + ofs % (width_ - 1);
+        cell_b = cell_a + 1;
+        if (bitboard_ && new_value == Border::kWall) {
+            bitboard_->SetHorizontalWall(ofs / (width_ - 1), ofs % (width_ - 1));
+        }
     } else {
         ofs -= height_ * (width_ - 1);
         assert(vertical_[ofs] == Border::kUndecided);
         vertical_[ofs] = new_value;
+        cell_a = ofs;
+        cell_b = ofs + width_;
+        if (bitboard_ && new_value == Border::kWall) {
+            bitboard_->SetVerticalWall(ofs / width_, ofs % width_);
+        }
+    }
+    bool is_same_color =
+        problem_.color(cell_a / width_, cell_a % width_) == problem_.color(cell_b / width_, cell_b % width_);
+    if (new_value == Border::kConnected) {
+        blocks_uf_.Union(cell_a, cell_b);
+        if (is_same_color) {
+            units_uf_.Union(cell_a, cell_b);
+        }
+    } else if (is_same_color) {
+        SplitPotentialUnit(cell_a, cell_b);
     }
+    decision_index_[v - origin_] = decisions_.size();
     decisions_.push_back(lit);
 }
 
@@ -56,15 +165,201 @@ void BoardManager::Undo(Glucose::Lit lit) {
     int ofs = v - origin_;
     assert(0 <= ofs && ofs < height_ * (width_ - 1) + (height_ - 1) * width_);
 
+    Border old_value;
+    int cell_a, cell_b;
     if (ofs < height_ * (width_ - 1)) {
+        old_value = horizontal_[ofs];
         horizontal_[ofs] = Border::kUndecided;
+        cell_a = ofs / (width_ - 1) * width_ + ofs % (width_ - 1);
+        cell_b = cell_a + 1;
+        if (bitboard_ && old_value == Border::kWall) {
+            bitboard_->ClearHorizontalWall(ofs / (width_ - 1), ofs % (width_ - 1));
+        }
     } else {
         ofs -= height_ * (width_ - 1);
+        old_value = vertical_[ofs];
         vertical_[ofs] = Border::kUndecided;
+        cell_a = ofs;
+        cell_b = ofs + width_;
+        if (bitboard_ && old_value == Border::kWall) {
+            bitboard_->ClearVerticalWall(ofs / width_, ofs % width_);
+        }
+    }
+    bool is_same_color =
+        problem_.color(cell_a / width_, cell_a % width_) == problem_.color(cell_b / width_, cell_b % width_);
+    if (old_value == Border::kConnected) {
+        if (is_same_color) {
+            units_uf_.Rollback();
+        }
+        blocks_uf_.Rollback();
+    } else if (!potential_unit_splits_.empty() &&
+               potential_unit_splits_.back().decision_index == decisions_.size() - 1) {
+        UndoPotentialUnitSplit();
     }
     decisions_.pop_back();
 }
 
+void BoardManager::DirtyCellsSince(int checkpoint, std::vector<int>& out) const {
+    assert(0 <= checkpoint && checkpoint <= NumDecisions());
+    for (int i = checkpoint; i < NumDecisions(); ++i) {
+        int ofs = Glucose::var(decisions_[i]) - origin_;
+        if (ofs < height_ * (width_ - 1)) {
+            int cell = ofs / (width_ - 1) * width_ + ofs % (width_ - 1);
+            out.push_back(cell);
+            out.push_back(cell + 1);
+        } else {
+            ofs -= height_ * (width_ - 1);
+            out.push_back(ofs);
+            out.push_back(ofs + width_);
+        }
+    }
+}
+
+int BoardManager::PotentialNeighbors(int cell, int out[4]) const {
+    int y = cell / width_;
+    int x = cell % width_;
+    int c = problem_.color(y, x);
+    int n = 0;
+
+    if (y > 0 && problem_.color(y - 1, x) == c && vertical(y - 1, x) != Border::kWall) {
+        out[n++] = cell - width_;
+    }
+    if (y < height_ - 1 && problem_.color(y + 1, x) == c && vertical(y, x) != Border::kWall) {
+        out[n++] = cell + width_;
+    }
+    if (x > 0 && problem_.color(y, x - 1) == c && horizontal(y, x - 1) != Border::kWall) {
+        out[n++] = cell - 1;
+    }
+    if (x < width_ - 1 && problem_.color(y, x + 1) == c && horizontal(y, x) != Border::kWall) {
+        out[n++] = cell + 1;
+    }
+    return n;
+}
+
+void BoardManager::SplitPotentialUnit(int cell_a, int cell_b) {
+    // `cell_a` and `cell_b` were in the same potential unit before the new wall between them was placed.
+    // Search from both cells alternately. If the searches meet, the potential unit is not split. Otherwise, the search
+    // which terminates first finds the smaller part, which is moved to a new potential unit.
+    // If both searches grow large, the bitboard (if available) is used instead to find the whole part containing
+    // `cell_a`, as a word-parallel flood fill is much cheaper than a cell-by-cell search on large potential units.
+    assert(potential_unit_id_[cell_a] == potential_unit_id_[cell_b]);
+    constexpr int kSearchLimitWithBitboard = 32;
+
+    if (search_epoch_ == (std::numeric_limits<int>::max() >> 1)) {
+        std::fill(search_visited_.begin(), search_visited_.end(), 0);
+        search_epoch_ = 0;
+    }
+    ++search_epoch_;
+    size_t head[2] = {0, 0};
+    for (int side = 0; side < 2; ++side) {
+        int start = side == 0 ? cell_a : cell_b;
+        search_queue_[side].clear();
+        search_queue_[side].push_back(start);
+        search_visited_[start] = (search_epoch_ << 1) | side;
+    }
+
+    int neighbors[4];
+    for (int side = 0;; side ^= 1) {
+        std::vector<int>& queue = search_queue_[side];
+        if (head[side] == queue.size()) {
+            // `queue` contains the whole part which is separated from the other one
+            int cells_offset = split_cells_.size();
+            split_cells_.insert(split_cells_.end(), queue.begin(), queue.end());
+            MoveToNewPotentialUnit(side == 0 ? cell_b : cell_a, cells_offset);
+            return;
+        }
+
+        if (bitboard_ && head[side] >= kSearchLimitWithBitboard) {
+            SplitPotentialUnitByBitboard(cell_a, cell_b);
+            return;
+        }
+
+        int c = queue[head[side]++];
+        int n = PotentialNeighbors(c, neighbors);
+        for (int i = 0; i < n; ++i) {
+            int c2 = neighbors[i];
+            if ((search_visited_[c2] >> 1) == search_epoch_) {
+                if ((search_visited_[c2] & 1) != side) {
+                    // The two searches met
+                    return;
+                }
+                continue;
+            }
+            search_visited_[c2] = (search_epoch_ << 1) | side;
+            queue.push_back(c2);
+        }
+    }
+}
+
+void BoardManager::SplitPotentialUnitByBitboard(int cell_a, int cell_b) {
+    bitboard_->FloodPotentialUnit(cell_a / width_, cell_a % width_, flood_);
+    if ((flood_[cell_b / width_] >> (cell_b % width_)) & 1) {
+        return;
+    }
+
+    int cells_offset = split_cells_.size();
+    for (int y = 0; y < height_; ++y) {
+        uint64_t mask = flood_[y];
+        while (mask != 0) {
+            int x = __builtin_ctzll(mask);
+            mask &= mask - 1;
+            split_cells_.push_back(y * width_ + x);
+        }
+    }
+    MoveToNewPotentialUnit(cell_b, cells_offset);
+}
+
+void BoardManager::MoveToNewPotentialUnit(int remaining_cell, int cells_offset) {
+    int original_id = potential_unit_id_[remaining_cell];
+    int new_id = potential_unit_size_.size();
+    potential_unit_splits_.push_back(
+        {(int)decisions_.size(), original_id, potential_unit_head_[original_id], cells_offset});
+
+    int moved = split_cells_.size() - cells_offset;
+    int first = split_cells_[cells_offset];
+    int last = split_cells_.back();
+    for (int i = cells_offset; i < split_cells_.size(); ++i) {
+        int c = split_cells_[i];
+        potential_unit_id_[c] = new_id;
+
+        // Unlink `c` from the original list and append it to the new one
+        potential_unit_next_[potential_unit_prev_[c]] = potential_unit_next_[c];
+        potential_unit_prev_[potential_unit_next_[c]] = potential_unit_prev_[c];
+        potential_unit_next_[c] = i + 1 < split_cells_.size() ? split_cells_[i + 1] : first;
+        potential_unit_prev_[c] = i > cells_offset ? split_cells_[i - 1] : last;
+    }
+    potential_unit_head_[original_id] = remaining_cell;
+    potential_unit_head_.push_back(first);
+    potential_unit_size_[original_id] -= moved;
+    potential_unit_size_.push_back(moved);
+}
+
+void BoardManager::UndoPotentialUnitSplit() {
+    PotentialUnitSplit split = potential_unit_splits_.back();
+    potential_unit_splits_.pop_back();
+
+    int moved = split_cells_.size() - split.cells_offset;
+    for (int i = split.cells_offset; i < split_cells_.size(); ++i) {
+        potential_unit_id_[split_cells_[i]] = split.original_id;
+    }
+
+    // Splice the list of the moved cells into the original one
+    int a = potential_unit_head_[split.original_id];
+    int b = potential_unit_head_.back();
+    int a_next = potential_unit_next_[a];
+    int b_prev = potential_unit_prev_[b];
+    potential_unit_next_[a] = b;
+    potential_unit_prev_[b] = a;
+    potential_unit_next_[b_prev] = a_next;
+    potential_unit_prev_[a_next] = b_prev;
+    potential_unit_head_[split.original_id] = split.original_head;
+
+    split_cells_.resize(split.cells_offset);
+    potential_unit_size_[split.original_id] += moved;
+    potential_unit_size_.pop_back();
+    potential_unit_head_.pop_back();
+}
+
 std::vector<Glucose::Var> BoardManager::RelatedVariables() const {
     std::vector<Glucose::Var> ret;
     int n_vars = height_ * (width_ - 1) + (height_ - 1) * width_;
@@ -74,104 +369,131 @@ std::vector<Glucose::Var> BoardManager::RelatedVariables() const {
     return ret;
 }
 
-std::vector<Glucose::Lit> BoardManager::ReasonForBlock(const BoardInfo& info, int block_id) const {
-    std::vector<Glucose::Lit> ret;
-    for (auto [y, x] : info.blocks.group(block_id)) {
-        if (y < height_ - 1 && info.blocks.group_id(y + 1, x) == block_id && vertical(y, x) == Border::kConnected) {
-            ret.push_back(Glucose::mkLit(VerticalVar(y, x), true));
+void BoardManager::ReasonForBlock(int y0, int x0, std::vector<Glucose::Lit>& out) const {
+    // A connected border always joins two cells of the same block
+    for (auto [y, x] : BlockCells(y0, x0)) {
+        if (y < height_ - 1 && vertical(y, x) == Border::kConnected) {
+            out.push_back(Glucose::mkLit(VerticalVar(y, x), true));
         }
-        if (x < width_ - 1 && info.blocks.group_id(y, x + 1) == block_id && horizontal(y, x) == Border::kConnected) {
-            ret.push_back(Glucose::mkLit(HorizontalVar(y, x), true));
+        if (x < width_ - 1 && horizontal(y, x) == Border::kConnected) {
+            out.push_back(Glucose::mkLit(HorizontalVar(y, x), true));
         }
     }
-    return ret;
 }
 
-std::vector<Glucose::Lit> BoardManager::ReasonForUnit(const BoardInfo& info, int block_id) const {
-    std::vector<Glucose::Lit> ret;
-    for (auto [y, x] : info.units.group(block_id)) {
-        if (y < height_ - 1 && info.units.group_id(y + 1, x) == block_id && vertical(y, x) == Border::kConnected) {
-            ret.push_back(Glucose::mkLit(VerticalVar(y, x), true));
+void BoardManager::ReasonForUnit(int y0, int x0, std::vector<Glucose::Lit>& out) const {
+    // A connected border between cells of the same color always joins two cells of the same unit
+    for (auto [y, x] : UnitCells(y0, x0)) {
+        if (y < height_ - 1 && problem_.color(y, x) == problem_.color(y + 1, x) &&
+            vertical(y, x) == Border::kConnected) {
+            out.push_back(Glucose::mkLit(VerticalVar(y, x), true));
         }
-        if (x < width_ - 1 && info.units.group_id(y, x + 1) == block_id && horizontal(y, x) == Border::kConnected) {
-            ret.push_back(Glucose::mkLit(HorizontalVar(y, x), true));
+        if (x < width_ - 1 && problem_.color(y, x) == problem_.color(y, x + 1) &&
+            horizontal(y, x) == Border::kConnected) {
+            out.push_back(Glucose::mkLit(HorizontalVar(y, x), true));
         }
     }
-    return ret;
 }
 
-std::vector<Glucose::Lit> BoardManager::ReasonForPotentialUnitBoundary(const BoardInfo& info,
-                                                                       int potential_unit_id) const {
-    std::vector<Glucose::Lit> ret;
-    for (auto [y, x] : info.potential_units.group(potential_unit_id)) {
-        if (y > 0 && info.potential_units.group_id(y - 1, x) != potential_unit_id &&
+void BoardManager::ReasonForPotentialUnitBoundary(int potential_unit_id, std::vector<Glucose::Lit>& out) const {
+    for (auto [y, x] : PotentialUnitCells(potential_unit_id)) {
+        if (y > 0 && PotentialUnitId(y - 1, x) != potential_unit_id &&
             problem_.color(y, x) == problem_.color(y - 1, x) && vertical(y - 1, x) == Border::kWall) {
-            ret.push_back(Glucose::mkLit(VerticalVar(y - 1, x)));
+            out.push_back(Glucose::mkLit(VerticalVar(y - 1, x)));
         }
-        if (y < height_ - 1 && info.potential_units.group_id(y + 1, x) != potential_unit_id &&
+        if (y < height_ - 1 && PotentialUnitId(y + 1, x) != potential_unit_id &&
             problem_.color(y, x) == problem_.color(y + 1, x) && vertical(y, x) == Border::kWall) {
-            ret.push_back(Glucose::mkLit(VerticalVar(y, x)));
+            out.push_back(Glucose::mkLit(VerticalVar(y, x)));
         }
-        if (x > 0 && info.potential_units.group_id(y, x - 1) != potential_unit_id &&
+        if (x > 0 && PotentialUnitId(y, x - 1) != potential_unit_id &&
             problem_.color(y, x) == problem_.color(y, x - 1) && horizontal(y, x - 1) == Border::kWall) {
-            ret.push_back(Glucose::mkLit(HorizontalVar(y, x - 1)));
+            out.push_back(Glucose::mkLit(HorizontalVar(y, x - 1)));
         }
-        if (x < width_ - 1 && info.potential_units.group_id(y, x + 1) != potential_unit_id &&
+        if (x < width_ - 1 && PotentialUnitId(y, x + 1) != potential_unit_id &&
             problem_.color(y, x) == problem_.color(y, x + 1) && horizontal(y, x) == Border::kWall) {
-            ret.push_back(Glucose::mkLit(HorizontalVar(y, x)));
+            out.push_back(Glucose::mkLit(HorizontalVar(y, x)));
         }
     }
-    return ret;
 }
 
-std::vector<Glucose::Lit> BoardManager::ReasonForPath(int ya, int xa, int yb, int xb) const {
-    Grid<std::pair<int, int>> from(height_, width_, std::make_pair(-1, -1));
-    from.at(ya, xa) = std::make_pair(-2, -2);
-
-    std::queue<std::pair<int, int>> qu;
-    qu.push({ya, xa});
-    while (!qu.empty()) {
-        auto [y, x] = qu.front();
-        qu.pop();
-        if (y == yb && x == xb) {
+void BoardManager::SearchConnectedCells(int start, int goal, int color, int count) const {
+    if (++reason_epoch_ == 0) {
+        std::fill(reason_visited_.begin(), reason_visited_.end(), 0);
+        std::fill(reason_used_.begin(), reason_used_.end(), 0);
+        reason_epoch_ = 1;
+    }
+    reason_queue_.clear();
+    reason_queue_.push_back(start);
+    reason_found_.clear();
+    reason_visited_[start] = reason_epoch_;
+    reason_from_[start] = -1;
+
+    for (size_t head = 0; head < reason_queue_.size(); ++head) {
+        int cell = reason_queue_[head];
+        if (cell == goal) {
             break;
         }
+        int y = cell / width_, x = cell % width_;
+        if (color >= 0 && problem_.color(y, x) == color) {
+            reason_found_.push_back(cell);
+            if ((int)reason_found_.size() >= count) {
+                break;
+            }
+        }
 
-        if (y > 0 && vertical(y - 1, x) == Border::kConnected && from.at(y - 1, x).first == -1) {
-            from.at(y - 1, x) = std::make_pair(y, x);
-            qu.push({y - 1, x});
+        auto visit = [&](int next) {
+            if (reason_visited_[next] != reason_epoch_) {
+                reason_visited_[next] = reason_epoch_;
+                reason_from_[next] = cell;
+                reason_queue_.push_back(next);
+            }
+        };
+        if (y > 0 && vertical(y - 1, x) == Border::kConnected) {
+            visit(cell - width_);
         }
-        if (y < height_ - 1 && vertical(y, x) == Border::kConnected && from.at(y + 1, x).first == -1) {
-            from.at(y + 1, x) = std::make_pair(y, x);
-            qu.push({y + 1, x});
+        if (y < height_ - 1 && vertical(y, x) == Border::kConnected) {
+            visit(cell + width_);
         }
-        if (x > 0 && horizontal(y, x - 1) == Border::kConnected && from.at(y, x - 1).first == -1) {
-            from.at(y, x - 1) = std::make_pair(y, x);
-            qu.push({y, x - 1});
+        if (x > 0 && horizontal(y, x - 1) == Border::kConnected) {
+            visit(cell - 1);
         }
-        if (x < width_ - 1 && horizontal(y, x) == Border::kConnected && from.at(y, x + 1).first == -1) {
-            from.at(y, x + 1) = std::make_pair(y, x);
-            qu.push({y, x + 1});
+        if (x < width_ - 1 && horizontal(y, x) == Border::kConnected) {
+            visit(cell + 1);
         }
     }
+}
 
-    assert(from.at(yb, xb).first != -1);
-
-    std::vector<Glucose::Lit> ret;
-    int y = yb;
-    int x = xb;
-    while (!(y == ya && x == xa)) {
-        auto [y_from, x_from] = from.at(y, x);
-
+void BoardManager::AddPathToReason(int cell, std::vector<Glucose::Lit>& out) const {
+    while (reason_from_[cell] != -1 && reason_used_[cell] != reason_epoch_) {
+        reason_used_[cell] = reason_epoch_;
+        int cell_from = reason_from_[cell];
+        int y = cell / width_, x = cell % width_;
+        int y_from = cell_from / width_, x_from = cell_from % width_;
         if (y == y_from) {
-            ret.push_back(Glucose::mkLit(HorizontalVar(y, std::min(x, x_from)), true));
+            out.push_back(Glucose::mkLit(HorizontalVar(y, std::min(x, x_from)), true));
         } else {
-            ret.push_back(Glucose::mkLit(VerticalVar(std::min(y, y_from), x), true));
+            out.push_back(Glucose::mkLit(VerticalVar(std::min(y, y_from), x), true));
         }
-        y = y_from;
-        x = x_from;
+        cell = cell_from;
+    }
+}
+
+void BoardManager::ReasonForPath(int ya, int xa, int yb, int xb, std::vector<Glucose::Lit>& out) const {
+    int goal = yb * width_ + xb;
+    SearchConnectedCells(ya * width_ + xa, goal, -1, 0);
+    assert(reason_visited_[goal] == reason_epoch_);
+    AddPathToReason(goal, out);
+}
+
+void BoardManager::ReasonForColorCount(int y, int x, int color, int count, std::vector<Glucose::Lit>& out) const {
+    // BFS until `count` cells of `color` are found
+    SearchConnectedCells(y * width_ + x, -1, color, count);
+    assert((int)reason_found_.size() >= count);
+
+    // Only the borders on the paths from (y, x) to the found cells are needed
+    for (int cell : reason_found_) {
+        AddPathToReason(cell, out);
     }
-    return ret;
 }
 
 void BoardManager::calcReasonSimple(Glucose::Lit p, Glucose::Lit extra, Glucose::vec<Glucose::Lit>& out_reason) {
@@ -195,58 +517,37 @@ Glucose::Var BoardManager::AllocateVariables(Glucose::Solver& solver, int height
 
 namespace {
 
-void ComputeConnectedComponentsSearch(const BoardManager& board, bool ignore_color, bool is_potential,
-                                      Grid<int>& group_id, int y, int x, int id) {
-    if (group_id.at(y, x) != -1) {
-        return;
-    }
-    group_id.at(y, x) = id;
-
-    auto maybe_traverse = [&](int y2, int x2, BoardManager::Border border) {
-        if (!ignore_color && board.problem().color(y2, x2) != board.problem().color(y, x)) {
-            return;
-        }
-        if (border == BoardManager::Border::kConnected ||
-            (is_potential && border == BoardManager::Border::kUndecided)) {
-            ComputeConnectedComponentsSearch(board, ignore_color, is_potential, group_id, y2, x2, id);
-        }
-    };
-
-    if (y > 0) {
-        maybe_traverse(y - 1, x, board.vertical(y - 1, x));
-    }
-    if (y < board.height() - 1) {
-        maybe_traverse(y + 1, x, board.vertical(y, x));
-    }
-    if (x > 0) {
-        maybe_traverse(y, x - 1, board.horizontal(y, x - 1));
-    }
-    if (x < board.width() - 1) {
-        maybe_traverse(y, x + 1, board.horizontal(y, x));
-    }
-}
-
-Grid<int> ComputeConnectedComponents(const BoardManager& board, bool ignore_color, bool is_potential) {
-    Grid<int> group_id(board.height(), board.width(), -1);
+// Assigns dense ids to the sets of `uf` in the order of their first appearance in the row-major order.
+// `root_to_id` is a work area whose size is the number of cells.
+void AssignUnionFindComponents(const RollbackUnionFind& uf, int width, GroupInfo& info, std::vector<int>& root_to_id) {
+    std::fill(root_to_id.begin(), root_to_id.end(), -1);
     int id_last = 0;
-    for (int y = 0; y < board.height(); ++y) {
-        for (int x = 0; x < board.width(); ++x) {
-            if (group_id.at(y, x) == -1) {
-                ComputeConnectedComponentsSearch(board, ignore_color, is_potential, group_id, y, x, id_last++);
-            }
+    info.Assign([&](int y, int x) {
+        int r = uf.Root(y * width + x);
+        if (root_to_id[r] == -1) {
+            root_to_id[r] = id_last++;
         }
-    }
-    return group_id;
+        return root_to_id[r];
+    });
 }
 
 } // namespace
 
 BoardInfo BoardManager::ComputeBoardInfo() const {
-    return BoardInfo{
-        ComputeConnectedComponents(*this, false, false),
-        ComputeConnectedComponents(*this, true, false),
-        ComputeConnectedComponents(*this, false, true),
+    BoardInfo info{
+        GroupInfo(height_, width_),
+        GroupInfo(height_, width_),
+        GroupInfo(height_, width_),
     };
+    ComputeBoardInfo(info);
+    return info;
+}
+
+void BoardManager::ComputeBoardInfo(BoardInfo& info) const {
+    root_to_id_.resize(height_ * width_);
+    AssignUnionFindComponents(units_uf_, width_, info.units, root_to_id_);
+    AssignUnionFindComponents(blocks_uf_, width_, info.blocks, root_to_id_);
+    info.potential_units.Assign([&](int y, int x) { return potential_unit_id_[y * width_ + x]; });
 }
 
 void BoardManager::Dump() const {
@@ -4,9 +4,12 @@
 
 #include "Grid.h"
 #include "Group.h"
+#include "doublechoco/Bitboard.h"
 #include "doublechoco/Problem.h"
+#include "doublechoco/RollbackUnionFind.h"
 
 #include <algorithm>
+#include <optional>
 #include <vector>
 
 namespace doublechoco {
@@ -21,6 +24,39 @@ struct BoardInfo {
     GroupInfo potential_units;
 };
 
+// Cells of a component (unit, block or potential unit), which are stored as a cyclic list. Iteration yields (y, x).
+class ComponentCells {
+public:
+    class Iterator {
+    public:
+        Iterator(const int* next, int width, int cell, int remaining)
+            : next_(next), width_(width), cell_(cell), remaining_(remaining) {}
+
+        std::pair<int, int> operator*() const { return {cell_ / width_, cell_ % width_}; }
+        Iterator& operator++() {
+            cell_ = next_[cell_];
+            --remaining_;
+            return *this;
+        }
+        bool operator!=(const Iterator& other) const { return remaining_ != other.remaining_; }
+
+    private:
+        const int* next_;
+        int width_, cell_, remaining_;
+    };
+
+    ComponentCells(const int* next, int width, int start, int size)
+        : next_(next), width_(width), start_(start), size_(size) {}
+
+    Iterator begin() const { return Iterator(next_, width_, start_, size_); }
+    Iterator end() const { return Iterator(next_, width_, start_, 0); }
+    int size() const { return size_; }
+
+private:
+    const int* next_;
+    int width_, start_, size_;
+};
+
 // This solver uses H * (W - 1) + (H - 1) * W variables to represent answers.
 // The first H * (W - 1) variables correspond to "horizontal" connections, and the remaining to "vertical".
 // For each variable, "true" means that there is a border at the corresponding location, and "false" means that the two
@@ -48,35 +84,138 @@ public:
     void Decide(Glucose::Lit lit);
     void Undo(Glucose::Lit lit);
 
-    std::vector<Glucose::Var> RelatedVariables() const;
+    // The number of decisions so far, which serves as a checkpoint for `DirtyCellsSince`. A checkpoint remains valid
+    // as long as `NumDecisions()` does not go below it.
+    int NumDecisions() const { return decisions_.size(); }
 
-    // Compute the reason (a set of literals) building a unit
-    std::vector<Glucose::Lit> ReasonForUnit(const BoardInfo& info, int block_id) const;
+    // Appends the cells adjacent to the borders decided after `checkpoint` to `out`, as indices (y * width + x).
+    // Only components containing these cells can have changed since then.
+    void DirtyCellsSince(int checkpoint, std::vector<int>& out) const;
 
-    // Compute the reason (a set of literals) building a block
-    std::vector<Glucose::Lit> ReasonForBlock(const BoardInfo& info, int block_id) const;
+    // The position of the decision of `var`, which must be decided, among the decisions so far
+    int DecisionIndex(Glucose::Var var) const { return decision_index_[var - origin_]; }
+
+    std::vector<Glucose::Var> RelatedVariables() const;
+
+    // Connectivity of units and blocks is maintained incrementally on `Decide` / `Undo`.
+    // Component ids are the index (y * width + x) of the representative cell, and valid only until the next
+    // `Decide` / `Undo`.
+    int UnitId(int y, int x) const { return units_uf_.Root(y * width_ + x); }
+    int BlockId(int y, int x) const { return blocks_uf_.Root(y * width_ + x); }
+    int UnitSize(int y, int x) const { return units_uf_.Size(y * width_ + x); }
+    int BlockSize(int y, int x) const { return blocks_uf_.Size(y * width_ + x); }
+    int BlockColorCount(int y, int x, int c) const { return blocks_uf_.ColorCount(y * width_ + x, c); }
+
+    // The cells of the unit / block containing (y, x), enumerated in O(its size) without `ComputeBoardInfo`
+    ComponentCells UnitCells(int y, int x) const {
+        int cell = y * width_ + x;
+        return ComponentCells(units_uf_.next().data(), width_, cell, units_uf_.Size(cell));
+    }
+    ComponentCells BlockCells(int y, int x) const {
+        int cell = y * width_ + x;
+        return ComponentCells(blocks_uf_.next().data(), width_, cell, blocks_uf_.Size(cell));
+    }
+
+    // Potential units are maintained decrementally: a new wall can only split the potential unit containing it, so only
+    // that unit is searched on `Decide`, and the split is reverted on `Undo`.
+    // Potential unit ids are dense (in [0, NumPotentialUnits())) but their order is unspecified.
+    int PotentialUnitId(int y, int x) const { return potential_unit_id_[y * width_ + x]; }
+    int PotentialUnitSize(int id) const { return potential_unit_size_[id]; }
+    int NumPotentialUnits() const { return potential_unit_size_.size(); }
+    ComponentCells PotentialUnitCells(int id) const {
+        return ComponentCells(potential_unit_next_.data(), width_, potential_unit_head_[id], potential_unit_size_[id]);
+    }
+
+    // Bit-packed copy of the board, which is available only if the width of the board is at most
+    // `Bitboard::kMaxWidth`. Returns nullptr otherwise.
+    const Bitboard* bitboard() const { return bitboard_ ? &*bitboard_ : nullptr; }
+
+    // The `ReasonFor*` functions append the reason (a set of literals) to `out`, so that callers can build a reason in
+    // a reused buffer without allocation.
+
+    // Compute the reason building the unit containing (y, x)
+    void ReasonForUnit(int y, int x, std::vector<Glucose::Lit>& out) const;
+
+    // Compute the reason building the block containing (y, x)
+    void ReasonForBlock(int y, int x, std::vector<Glucose::Lit>& out) const;
 
     // Compute the reason prohibiting a potential unit from expanding
-    std::vector<Glucose::Lit> ReasonForPotentialUnitBoundary(const BoardInfo& info, int potential_unit_id) const;
+    void ReasonForPotentialUnitBoundary(int potential_unit_id, std::vector<Glucose::Lit>& out) const;
 
     // Compute the reason why cells (ya, xa) and (yb, xb) are connected
-    std::vector<Glucose::Lit> ReasonForPath(int ya, int xa, int yb, int xb) const;
+    void ReasonForPath(int ya, int xa, int yb, int xb, std::vector<Glucose::Lit>& out) const;
+
+    // Compute the reason why the block containing (y, x) has at least `count` cells of color `color`, that is,
+    // connected borders spanning (y, x) and `count` such cells
+    void ReasonForColorCount(int y, int x, int color, int count, std::vector<Glucose::Lit>& out) const;
 
     // Computes the most straightforward "reason", in which all the known decisions are related.
     void calcReasonSimple(Glucose::Lit p, Glucose::Lit extra, Glucose::vec<Glucose::Lit>& out_reason);
 
     static Glucose::Var AllocateVariables(Glucose::Solver& solver, int height, int width);
 
+    // Materializes all the components in O(HW). The propagator does not need this since the accessors above are
+    // maintained incrementally, but this is handy for inspecting the board.
     BoardInfo ComputeBoardInfo() const;
 
+    // Same as `ComputeBoardInfo()`, but reuses `info`, which must be for a board of the same size
+    void ComputeBoardInfo(BoardInfo& info) const;
+
     void Dump() const;
 
 private:
+    struct PotentialUnitSplit {
+        int decision_index; // index in `decisions_` of the wall which caused this split
+        int original_id;
+        int original_head;
+        int cells_offset; // cells moved to the new potential unit are `split_cells_[cells_offset..]`
+    };
+
+    // Stores the cells adjacent to `cell` reachable without crossing walls or cells of the other color to `out`, and
+    // returns the number of such cells.
+    int PotentialNeighbors(int cell, int out[4]) const;
+    void SplitPotentialUnit(int cell_a, int cell_b);
+    void SplitPotentialUnitByBitboard(int cell_a, int cell_b);
+    // Moves `split_cells_[cells_offset..]` from the potential unit containing `remaining_cell` to a new one
+    void MoveToNewPotentialUnit(int remaining_cell, int cells_offset);
+    void UndoPotentialUnitSplit();
+
+    // BFS from `start` over connected borders, recording the tree in `reason_from_`. Stops when `goal` is reached, or
+    // when `count` cells of `color` (if nonnegative) are found, which are stored to `reason_found_`.
+    void SearchConnectedCells(int start, int goal, int color, int count) const;
+
+    // Appends the borders on the path in `reason_from_` from `cell` back to the start or a cell already added
+    void AddPathToReason(int cell, std::vector<Glucose::Lit>& out) const;
+
     int height_, width_;
     Problem problem_;
     Glucose::Var origin_;
     std::vector<Border> horizontal_, vertical_;
     std::vector<Glucose::Lit> decisions_;
+    std::vector<int> decision_index_;
+    RollbackUnionFind units_uf_, blocks_uf_;
+
+    std::vector<int> potential_unit_id_, potential_unit_size_;
+    // Cells of each potential unit form a doubly linked cyclic list, and `potential_unit_head_` is one of the cells
+    std::vector<int> potential_unit_next_, potential_unit_prev_, potential_unit_head_;
+    std::vector<PotentialUnitSplit> potential_unit_splits_;
+    std::vector<int> split_cells_;
+
+    std::optional<Bitboard> bitboard_;
+
+    // Work area for `SplitPotentialUnit`
+    std::vector<int> search_queue_[2];
+    std::vector<uint64_t> flood_;
+    std::vector<int> search_visited_; // (epoch << 1) | side
+    int search_epoch_;
+
+    // Work area for `ComputeBoardInfo`
+    mutable std::vector<int> root_to_id_;
+
+    // Work area for `ReasonForPath` and `ReasonForColorCount`
+    mutable std::vector<int> reason_from_, reason_queue_, reason_found_;
+    mutable std::vector<unsigned int> reason_visited_, reason_used_;
+    mutable unsigned int reason_epoch_;
 };
 
 }
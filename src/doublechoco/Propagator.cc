@@ -1,13 +1,66 @@
 #include "Propagator.h"
 
-#include <set>
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <tuple>
 
+#include "ConnectedComponents.h"
 #include "Grid.h"
 #include "doublechoco/Shape.h"
 
 namespace doublechoco {
 
-Propagator::Propagator(const Problem& problem, Glucose::Var origin) : problem_(problem), board_(problem, origin) {}
+namespace {
+
+// Cells of the same color are connected regardless of borders.
+struct ColorRegionPolicy {
+    const Problem& problem;
+
+    bool Contains(int y, int x) const { return true; }
+    bool Passable(int y, int x, int y2, int x2) const { return problem.color(y, x) == problem.color(y2, x2); }
+};
+
+} // namespace
+
+Propagator::Propagator(const Problem& problem, Glucose::Var origin)
+    : problem_(problem), board_(problem, origin), origin_(origin),
+      transform_cache_(problem.height() * problem.width()), color_regions_(problem.height(), problem.width()),
+      dirty_potential_unit_(problem.height() * problem.width(), 0),
+      dirty_block_(problem.height() * problem.width(), 0), dirty_epoch_(0),
+      block_clue_(problem.height() * problem.width()), block_clue_mark_(problem.height() * problem.width(), 0),
+      shape_check_mark_(problem.height() * problem.width(), 0),
+      unit_checked_mark_(problem.height() * problem.width(), 0), shape_check_epoch_(0),
+      adjacent_mark_(problem.height() * problem.width(), 0), adjacent_mark_epoch_(0), region_mark_epoch_(0),
+      wall_mark_(problem.height() * (problem.width() - 1) + (problem.height() - 1) * problem.width(), 0),
+      wall_mark_epoch_(0) {
+    Grid<int> region_id(problem.height(), problem.width(), -1);
+    std::vector<std::pair<int, int>> stack;
+    LabelConnectedComponents(ColorRegionPolicy{problem}, region_id, stack);
+    color_regions_.Assign([&](int y, int x) { return region_id.at(y, x); });
+    region_mark_.assign(color_regions_.num_groups(), 0);
+
+    // Reserve the work areas for their maximum sizes, so that nothing is allocated during the search
+    int num_cells = problem.height() * problem.width();
+    int num_borders = wall_mark_.size();
+    cheap_checkpoints_.reserve(num_borders + 1);
+    expensive_checkpoints_.reserve(num_borders + 1);
+    dirty_cells_.reserve(num_borders * 2);
+    dirty_potential_units_.reserve(num_cells);
+    dirty_blocks_.reserve(num_cells);
+    shape_check_potential_units_.reserve(num_cells);
+    adjacent_potential_units_.reserve(num_cells);
+    shape_.cells.reserve(num_cells);
+    shape_.connections.reserve(num_borders);
+    origins_.reserve(num_cells);
+    // The parts of a reason (such as the walls for each color region) may share some borders
+    reason_.reserve(num_borders * 4);
+    shape_regions_.reserve(color_regions_.num_groups());
+    reason_cut_.reserve(num_borders);
+    reason_blockers_.reserve(num_borders);
+    reason_boundary_.reserve(num_borders);
+    blocker_candidates_.reserve(num_cells * 8);
+}
 
 std::vector<Glucose::Var> Propagator::RelatedVariables() {
     return board_.RelatedVariables();
@@ -19,6 +72,129 @@ void Propagator::SimplePropagatorDecide(Glucose::Lit p) {
 
 void Propagator::SimplePropagatorUndo(Glucose::Lit p) {
     board_.Undo(p);
+    for (auto* checkpoints : {&cheap_checkpoints_, &expensive_checkpoints_}) {
+        while (!checkpoints->empty() && checkpoints->back() > board_.NumDecisions()) {
+            checkpoints->pop_back();
+        }
+    }
+}
+
+void Propagator::MarkDirtyRegion(const std::vector<int>& checkpoints) {
+    int height = problem_.height();
+    int width = problem_.width();
+    ++dirty_epoch_;
+    if (dirty_epoch_ == 0) {
+        std::fill(dirty_potential_unit_.begin(), dirty_potential_unit_.end(), 0);
+        std::fill(dirty_block_.begin(), dirty_block_.end(), 0);
+        std::fill(block_clue_mark_.begin(), block_clue_mark_.end(), 0);
+        dirty_epoch_ = 1;
+    }
+    dirty_potential_units_.clear();
+    dirty_blocks_.clear();
+
+    auto mark_potential_unit = [&](int p) {
+        if (dirty_potential_unit_[p] != dirty_epoch_) {
+            dirty_potential_unit_[p] = dirty_epoch_;
+            dirty_potential_units_.push_back(p);
+        }
+    };
+    auto mark_block = [&](int y, int x) {
+        int b = board_.BlockId(y, x);
+        if (dirty_block_[b] != dirty_epoch_) {
+            dirty_block_[b] = dirty_epoch_;
+            dirty_blocks_.push_back(b);
+        }
+    };
+
+    if (checkpoints.empty()) {
+        // Nothing has been checked yet
+        for (int i = 0; i < board_.NumPotentialUnits(); ++i) {
+            mark_potential_unit(i);
+        }
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                mark_block(y, x);
+            }
+        }
+        return;
+    }
+
+    dirty_cells_.clear();
+    board_.DirtyCellsSince(checkpoints.back(), dirty_cells_);
+    for (int cell : dirty_cells_) {
+        int y = cell / width, x = cell % width;
+        mark_potential_unit(board_.PotentialUnitId(y, x));
+        mark_block(y, x);
+    }
+    // The checks of a block also depend on the potential units intersecting it
+    for (int p : dirty_potential_units_) {
+        for (auto [y, x] : board_.PotentialUnitCells(p)) {
+            mark_block(y, x);
+        }
+    }
+}
+
+const std::pair<int, std::pair<int, int>>& Propagator::BlockClue(int block_id) {
+    if (block_clue_mark_[block_id] != dirty_epoch_) {
+        block_clue_mark_[block_id] = dirty_epoch_;
+        block_clue_[block_id] = {-1, {-1, -1}};
+        int width = problem_.width();
+        for (auto [y, x] : board_.BlockCells(block_id / width, block_id % width)) {
+            if (problem_.num(y, x) > 0) {
+                block_clue_[block_id] = {problem_.num(y, x), {y, x}};
+                break;
+            }
+        }
+    }
+    return block_clue_[block_id];
+}
+
+void Propagator::CollectAdjacentPotentialUnits(int potential_unit_id) {
+    int height = problem_.height();
+    int width = problem_.width();
+    ++adjacent_mark_epoch_;
+    if (adjacent_mark_epoch_ == 0) {
+        std::fill(adjacent_mark_.begin(), adjacent_mark_.end(), 0);
+        adjacent_mark_epoch_ = 1;
+    }
+    adjacent_potential_units_.clear();
+
+    auto add = [&](int y, int x) {
+        int q = board_.PotentialUnitId(y, x);
+        if (adjacent_mark_[q] != adjacent_mark_epoch_) {
+            adjacent_mark_[q] = adjacent_mark_epoch_;
+            adjacent_potential_units_.push_back(q);
+        }
+    };
+    for (auto [y, x] : board_.PotentialUnitCells(potential_unit_id)) {
+        if (y > 0 && problem_.color(y, x) != problem_.color(y - 1, x) &&
+            board_.vertical(y - 1, x) != BoardManager::Border::kWall) {
+            add(y - 1, x);
+        }
+        if (y < height - 1 && problem_.color(y, x) != problem_.color(y + 1, x) &&
+            board_.vertical(y, x) != BoardManager::Border::kWall) {
+            add(y + 1, x);
+        }
+        if (x > 0 && problem_.color(y, x) != problem_.color(y, x - 1) &&
+            board_.horizontal(y, x - 1) != BoardManager::Border::kWall) {
+            add(y, x - 1);
+        }
+        if (x < width - 1 && problem_.color(y, x) != problem_.color(y, x + 1) &&
+            board_.horizontal(y, x) != BoardManager::Border::kWall) {
+            add(y, x + 1);
+        }
+    }
+}
+
+void Propagator::AddCheckpoint(std::vector<int>& checkpoints) {
+    if (num_pending_propagation() > 0) {
+        // Some literals were enqueued during the check, so the current state is not at fixpoint
+        return;
+    }
+    int n = board_.NumDecisions();
+    if (checkpoints.empty() || checkpoints.back() < n) {
+        checkpoints.push_back(n);
+    }
 }
 
 namespace {
@@ -60,310 +236,589 @@ void Transform(const std::vector<std::pair<int, int>>& group, const std::vector<
     std::sort(group_new.begin(), group_new.end());
 }
 
-void EnumerateTransforms(const Shape& shape, std::vector<Shape>& ret) {
-    ret.resize(8);
-    ret[0] = shape;
-    int num = 1;
+// Checks whether a shape with `connections` can be placed so that its (0, 0) cell comes to (origin_y, origin_x).
+bool CanPlaceShape(const Problem& problem, const BoardManager& board,
+                   const std::vector<std::pair<int, int>>& connections, int origin_y, int origin_x) {
+    int height = problem.height();
+    int width = problem.width();
 
-    ret[0].Rotate180To(ret[1]);
-    if (!(ret[0] == ret[1])) {
-        num = 2;
-    }
+    for (auto [dy, dx] : connections) {
+        int py = origin_y * 2 + dy;
+        int px = origin_x * 2 + dx;
 
-    {
-        for (int i = 0; i < num; ++i) {
-            ret[i].Rotate90To(ret[i + num]);
+        if (!(0 <= py && py <= (height - 1) * 2 && 0 <= px && px <= (width - 1) * 2)) {
+            return false;
         }
-        bool is_unique = true;
-        for (int i = 0; i < num; ++i) {
-            if (ret[i] == ret[num]) {
-                is_unique = false;
-                break;
-            }
+        if (problem.color(py >> 1, px >> 1) != problem.color((py + 1) >> 1, (px + 1) >> 1)) {
+            return false;
         }
-        if (is_unique) {
-            num *= 2;
+        if ((py & 1) == 1) {
+            if (board.vertical(py >> 1, px >> 1) == BoardManager::Border::kWall) {
+                return false;
+            }
+        } else {
+            if (board.horizontal(py >> 1, px >> 1) == BoardManager::Border::kWall) {
+                return false;
+            }
         }
     }
 
-    {
-        for (int i = 0; i < num; ++i) {
-            ret[i].FlipYTo(ret[i + num]);
-        }
-        bool is_unique = true;
-        for (int i = 0; i < num; ++i) {
-            if (ret[i] == ret[num]) {
-                is_unique = false;
-                break;
-            }
+    return true;
+}
+
+// Same as `CanPlaceShape`, but tests a whole row of connections at once.
+bool CanPlaceShapeByBitboard(const Bitboard& bitboard, const ShapeConnectionMasks& masks, int origin_y,
+                             int origin_x) {
+    if (masks.row_min > masks.row_max) {
+        // no connections
+        return true;
+    }
+
+    int top = origin_y + masks.row_min;
+    int left = origin_x + masks.col_min;
+    if (top < 0 || origin_y + masks.row_max >= bitboard.height() || left < 0 ||
+        origin_x + masks.col_max >= bitboard.width()) {
+        return false;
+    }
+    assert(!masks.horizontal.empty());
+
+    for (int i = 0; i < (int)masks.horizontal.size(); ++i) {
+        int y = top + i;
+        uint64_t h = masks.horizontal[i] << left;
+        uint64_t v = masks.vertical[i] << left;
+
+        // Borders between differently colored cells (or outside the board) can never be connected
+        if (((h & ~bitboard.horizontal_same_color(y)) | (v & ~bitboard.vertical_same_color(y))) != 0) {
+            return false;
         }
-        if (is_unique) {
-            num *= 2;
+        if (((h & bitboard.horizontal_wall(y)) | (v & bitboard.vertical_wall(y))) != 0) {
+            return false;
         }
     }
 
-    for (int i = num; i < 8; ++i) {
-        ret[i].clear();
+    return true;
+}
+
+// Checks whether a shape with `connections` placed at (origin_y, origin_x) is within the board and all of its cells
+// have the same color, that is, whether it can be placed if the borders are ignored.
+bool FitsColors(const Problem& problem, const std::vector<std::pair<int, int>>& connections, int origin_y,
+                int origin_x) {
+    int height = problem.height();
+    int width = problem.width();
+
+    for (auto [dy, dx] : connections) {
+        int py = origin_y * 2 + dy;
+        int px = origin_x * 2 + dx;
+
+        if (!(0 <= py && py <= (height - 1) * 2 && 0 <= px && px <= (width - 1) * 2)) {
+            return false;
+        }
+        if (problem.color(py >> 1, px >> 1) != problem.color((py + 1) >> 1, (px + 1) >> 1)) {
+            return false;
+        }
     }
+    return true;
 }
 
 } // namespace
 
-std::optional<std::vector<Glucose::Lit>> Propagator::DetectInconsistency() {
+const std::vector<Glucose::Lit>* Propagator::DetectInconsistency() {
     int height = problem_.height();
     int width = problem_.width();
-    BoardInfo info = board_.ComputeBoardInfo();
+    MarkDirtyRegion(cheap_checkpoints_);
+    reason_.clear();
 
     // connecter & size checker
-    for (int i = 0; i < info.blocks.num_groups(); ++i) {
-        int num = -1;
+    for (int i : dirty_blocks_) {
+        int num = BlockClue(i).first;
         bool has_num[2] = {false, false};
-        int size_by_color[2] = {0, 0};
+        int size_by_color[2] = {
+            board_.BlockColorCount(i / width, i % width, 0),
+            board_.BlockColorCount(i / width, i % width, 1),
+        };
         int potential_unit_id[2] = {-1, -1};
-        for (auto [y, x] : info.blocks.group(i)) {
+        std::pair<int, int> first_cell[2] = {{-1, -1}, {-1, -1}}; // a cell of each color in the block
+        for (auto [y, x] : board_.BlockCells(i / width, i % width)) {
             int c = problem_.color(y, x);
-            int pb_id = info.potential_units.group_id(y, x);
+            int pb_id = board_.PotentialUnitId(y, x);
             if (potential_unit_id[c] == -1) {
                 potential_unit_id[c] = pb_id;
+                first_cell[c] = {y, x};
             } else if (potential_unit_id[c] != pb_id) {
                 // Multiple units of the same color in a block
-                // TODO: compute more refined reason
-                auto ret = board_.ReasonForBlock(info, i);
-                auto app = board_.ReasonForPotentialUnitBoundary(info, pb_id);
-                ret.insert(ret.end(), app.begin(), app.end());
-                return ret;
+                board_.ReasonForPath(first_cell[c].first, first_cell[c].second, y, x, reason_);
+                board_.ReasonForPotentialUnitBoundary(pb_id, reason_);
+                return &reason_;
             }
 
-            ++size_by_color[c];
             int n = problem_.num(y, x);
             if (n > 0) {
                 has_num[c] = true;
-                if (num == -1) {
-                    num = n;
-                } else if (num != n) {
+                if (num != n) {
                     // Different clue numbers in a block
-                    // TODO: compute more refined reason (path connecting <num> and (y, x))
-                    return board_.ReasonForBlock(info, i);
+                    auto [clue_y, clue_x] = BlockClue(i).second;
+                    board_.ReasonForPath(clue_y, clue_x, y, x, reason_);
+                    return &reason_;
                 }
             }
         }
 
         // Connected component of a color is unconditionally larger than that of the another color
-        if (potential_unit_id[0] != -1 && info.potential_units.group(potential_unit_id[0]).size() < size_by_color[1]) {
-            auto ret = board_.ReasonForBlock(info, i);
-            auto app = board_.ReasonForPotentialUnitBoundary(info, potential_unit_id[0]);
-            ret.insert(ret.end(), app.begin(), app.end());
-            return ret;
-        }
-        if (potential_unit_id[1] != -1 && info.potential_units.group(potential_unit_id[1]).size() < size_by_color[0]) {
-            auto ret = board_.ReasonForBlock(info, i);
-            auto app = board_.ReasonForPotentialUnitBoundary(info, potential_unit_id[1]);
-            ret.insert(ret.end(), app.begin(), app.end());
-            return ret;
+        for (int c = 0; c < 2; ++c) {
+            if (potential_unit_id[c] == -1) {
+                continue;
+            }
+            int potential_size = board_.PotentialUnitSize(potential_unit_id[c]);
+            if (potential_size < size_by_color[c ^ 1]) {
+                board_.ReasonForColorCount(first_cell[c].first, first_cell[c].second, c ^ 1, potential_size + 1,
+                                           reason_);
+                board_.ReasonForPotentialUnitBoundary(potential_unit_id[c], reason_);
+                return &reason_;
+            }
         }
 
         if (num != -1) {
+            auto [clue_y, clue_x] = BlockClue(i).second;
+
             // Connected component larger than the clue number
-            if (num < size_by_color[0] || num < size_by_color[1]) {
-                return board_.ReasonForBlock(info, i);
+            for (int c = 0; c < 2; ++c) {
+                if (num < size_by_color[c]) {
+                    board_.ReasonForColorCount(clue_y, clue_x, c, num + 1, reason_);
+                    return &reason_;
+                }
             }
 
             // Possible connected component size smaller than the clue number
-            // TODO: compute more refined reason
-            if (potential_unit_id[0] != -1 && num > info.potential_units.group(potential_unit_id[0]).size()) {
-                auto ret = board_.ReasonForPotentialUnitBoundary(info, potential_unit_id[0]);
-                if (!has_num[0]) {
-                    auto app = board_.ReasonForBlock(info, i);
-                    ret.insert(ret.end(), app.begin(), app.end());
-                }
-                return ret;
-            }
-            if (potential_unit_id[1] != -1 && num > info.potential_units.group(potential_unit_id[1]).size()) {
-                auto ret = board_.ReasonForPotentialUnitBoundary(info, potential_unit_id[1]);
-                if (!has_num[1]) {
-                    auto app = board_.ReasonForBlock(info, i);
-                    ret.insert(ret.end(), app.begin(), app.end());
+            for (int c = 0; c < 2; ++c) {
+                if (potential_unit_id[c] != -1 && num > board_.PotentialUnitSize(potential_unit_id[c])) {
+                    board_.ReasonForPotentialUnitBoundary(potential_unit_id[c], reason_);
+                    if (!has_num[c]) {
+                        // The clue has the other color, so it must be shown that the clue is in this block
+                        board_.ReasonForPath(clue_y, clue_x, first_cell[c].first, first_cell[c].second, reason_);
+                    }
+                    return &reason_;
                 }
-                return ret;
             }
         }
     }
 
-    for (int y = 0; y < height; ++y) {
-        for (int x = 0; x < width; ++x) {
-            if (y < height - 1 && info.blocks.group_id(y, x) == info.blocks.group_id(y + 1, x) &&
-                board_.vertical(y, x) == BoardManager::Border::kWall) {
-                auto ret = board_.ReasonForPath(y, x, y + 1, x);
-                ret.push_back(Glucose::mkLit(board_.VerticalVar(y, x)));
-                return ret;
+    // A wall inside a block. Both of its cells are in the block, so only borders below and to the right of the cells
+    // are examined.
+    for (int i : dirty_blocks_) {
+        for (auto [y, x] : board_.BlockCells(i / width, i % width)) {
+            if (y < height - 1 && board_.vertical(y, x) == BoardManager::Border::kWall &&
+                board_.BlockId(y + 1, x) == i) {
+                board_.ReasonForPath(y, x, y + 1, x, reason_);
+                reason_.push_back(Glucose::mkLit(board_.VerticalVar(y, x)));
+                return &reason_;
             }
-            if (x < width - 1 && info.blocks.group_id(y, x) == info.blocks.group_id(y, x + 1) &&
-                board_.horizontal(y, x) == BoardManager::Border::kWall) {
-                auto ret = board_.ReasonForPath(y, x, y, x + 1);
-                ret.push_back(Glucose::mkLit(board_.HorizontalVar(y, x)));
-                return ret;
+            if (x < width - 1 && board_.horizontal(y, x) == BoardManager::Border::kWall &&
+                board_.BlockId(y, x + 1) == i) {
+                board_.ReasonForPath(y, x, y, x + 1, reason_);
+                reason_.push_back(Glucose::mkLit(board_.HorizontalVar(y, x)));
+                return &reason_;
             }
         }
     }
 
-    // shape finder
-    std::set<std::pair<int, int>> adjacent_potential_units_set;
-    for (int y = 0; y < height; ++y) {
-        for (int x = 0; x < width; ++x) {
-            if (y < height - 1 && problem_.color(y, x) != problem_.color(y + 1, x) &&
-                board_.vertical(y, x) != BoardManager::Border::kWall) {
-                int i = info.potential_units.group_id(y, x);
-                int j = info.potential_units.group_id(y + 1, x);
-                adjacent_potential_units_set.insert({i, j});
-                adjacent_potential_units_set.insert({j, i});
+    // Implications on undecided borders:
+    // - a border inside a block must be connected
+    // - a border between blocks with different clue numbers must be a wall
+    auto imply_border = [&](int ya, int xa, int yb, int xb, Glucose::Var var) -> const std::vector<Glucose::Lit>* {
+        int block_a = board_.BlockId(ya, xa);
+        int block_b = board_.BlockId(yb, xb);
+        if (block_a == block_b) {
+            reason_.clear();
+            board_.ReasonForPath(ya, xa, yb, xb, reason_);
+            Glucose::Lit lit = Glucose::mkLit(var, true);
+            if (!Imply(lit, reason_)) {
+                reason_.push_back(~lit);
+                return &reason_;
             }
-            if (x < width - 1 && problem_.color(y, x) != problem_.color(y, x + 1) &&
-                board_.horizontal(y, x) != BoardManager::Border::kWall) {
-                int i = info.potential_units.group_id(y, x);
-                int j = info.potential_units.group_id(y, x + 1);
-                adjacent_potential_units_set.insert({i, j});
-                adjacent_potential_units_set.insert({j, i});
+        } else if (BlockClue(block_a).first != -1 && BlockClue(block_b).first != -1 &&
+                   BlockClue(block_a).first != BlockClue(block_b).first) {
+            auto [ca_y, ca_x] = BlockClue(block_a).second;
+            auto [cb_y, cb_x] = BlockClue(block_b).second;
+            reason_.clear();
+            board_.ReasonForPath(ca_y, ca_x, ya, xa, reason_);
+            board_.ReasonForPath(cb_y, cb_x, yb, xb, reason_);
+            Glucose::Lit lit = Glucose::mkLit(var, false);
+            if (!Imply(lit, reason_)) {
+                reason_.push_back(~lit);
+                return &reason_;
+            }
+        }
+        return nullptr;
+    };
+    // Borders between two clean blocks were examined at the last checkpoint. Borders above and to the left of a cell
+    // are examined only if they are not examined from the other side.
+    for (int i : dirty_blocks_) {
+        for (auto [y, x] : board_.BlockCells(i / width, i % width)) {
+            if (y < height - 1 && board_.vertical(y, x) == BoardManager::Border::kUndecided) {
+                const std::vector<Glucose::Lit>* res = imply_border(y, x, y + 1, x, board_.VerticalVar(y, x));
+                if (res) {
+                    return res;
+                }
+            }
+            if (x < width - 1 && board_.horizontal(y, x) == BoardManager::Border::kUndecided) {
+                const std::vector<Glucose::Lit>* res = imply_border(y, x, y, x + 1, board_.HorizontalVar(y, x));
+                if (res) {
+                    return res;
+                }
+            }
+            if (y > 0 && board_.vertical(y - 1, x) == BoardManager::Border::kUndecided &&
+                dirty_block_[board_.BlockId(y - 1, x)] != dirty_epoch_) {
+                const std::vector<Glucose::Lit>* res = imply_border(y - 1, x, y, x, board_.VerticalVar(y - 1, x));
+                if (res) {
+                    return res;
+                }
+            }
+            if (x > 0 && board_.horizontal(y, x - 1) == BoardManager::Border::kUndecided &&
+                dirty_block_[board_.BlockId(y, x - 1)] != dirty_epoch_) {
+                const std::vector<Glucose::Lit>* res = imply_border(y, x - 1, y, x, board_.HorizontalVar(y, x - 1));
+                if (res) {
+                    return res;
+                }
             }
         }
     }
-    std::vector<std::vector<int>> adjacent_potential_units(info.potential_units.num_groups());
-    for (auto [i, j] : adjacent_potential_units_set) {
-        adjacent_potential_units[i].push_back(j);
-    }
-
-    Shape shape;
-    auto& transforms = transforms_;
 
-    std::vector<std::pair<int, int>> origins;
+    // A potential unit must be connected to a cell of the other color. If only one border to such a cell is not a
+    // wall, it must be connected.
+    for (int i : dirty_potential_units_) {
+        int n_candidates = 0;
+        // the last border found, and whether it is undecided
+        std::pair<Glucose::Var, bool> last_candidate = {-1, false};
+        auto add_candidate = [&](Glucose::Var var, BoardManager::Border border) {
+            if (border != BoardManager::Border::kWall) {
+                ++n_candidates;
+                last_candidate = {var, border == BoardManager::Border::kUndecided};
+            }
+        };
+        for (auto [y, x] : board_.PotentialUnitCells(i)) {
+            if (y > 0 && problem_.color(y, x) != problem_.color(y - 1, x)) {
+                add_candidate(board_.VerticalVar(y - 1, x), board_.vertical(y - 1, x));
+            }
+            if (y < height - 1 && problem_.color(y, x) != problem_.color(y + 1, x)) {
+                add_candidate(board_.VerticalVar(y, x), board_.vertical(y, x));
+            }
+            if (x > 0 && problem_.color(y, x) != problem_.color(y, x - 1)) {
+                add_candidate(board_.HorizontalVar(y, x - 1), board_.horizontal(y, x - 1));
+            }
+            if (x < width - 1 && problem_.color(y, x) != problem_.color(y, x + 1)) {
+                add_candidate(board_.HorizontalVar(y, x), board_.horizontal(y, x));
+            }
+        }
 
-    for (int i = 0; i < info.units.num_groups(); ++i) {
-        // Find the same shape (of the opposite color) in a neighboring potential unit
-        shape.clear();
-        origins.clear();
+        if (n_candidates == 1 && last_candidate.second) {
+            Glucose::Lit lit = Glucose::mkLit(last_candidate.first, true);
 
-        for (auto [y, x] : info.units.group(i)) {
-            if (y < height - 1 && info.units.group_id(y + 1, x) == i) {
-                shape.connections.push_back({y * 2 + 1, x * 2});
+            reason_.clear();
+            board_.ReasonForPotentialUnitBoundary(i, reason_);
+            for (auto [y, x] : board_.PotentialUnitCells(i)) {
+                if (y > 0 && problem_.color(y, x) != problem_.color(y - 1, x) &&
+                    board_.vertical(y - 1, x) == BoardManager::Border::kWall) {
+                    reason_.push_back(Glucose::mkLit(board_.VerticalVar(y - 1, x)));
+                }
+                if (y < height - 1 && problem_.color(y, x) != problem_.color(y + 1, x) &&
+                    board_.vertical(y, x) == BoardManager::Border::kWall) {
+                    reason_.push_back(Glucose::mkLit(board_.VerticalVar(y, x)));
+                }
+                if (x > 0 && problem_.color(y, x) != problem_.color(y, x - 1) &&
+                    board_.horizontal(y, x - 1) == BoardManager::Border::kWall) {
+                    reason_.push_back(Glucose::mkLit(board_.HorizontalVar(y, x - 1)));
+                }
+                if (x < width - 1 && problem_.color(y, x) != problem_.color(y, x + 1) &&
+                    board_.horizontal(y, x) == BoardManager::Border::kWall) {
+                    reason_.push_back(Glucose::mkLit(board_.HorizontalVar(y, x)));
+                }
             }
-            if (x < width - 1 && info.units.group_id(y, x + 1) == i) {
-                shape.connections.push_back({y * 2, x * 2 + 1});
+            if (!Imply(lit, reason_)) {
+                reason_.push_back(~lit);
+                return &reason_;
             }
         }
-        for (auto [y, x] : info.units.group(i)) {
-            shape.cells.push_back({y, x});
+    }
+
+    AddCheckpoint(cheap_checkpoints_);
+    return nullptr;
+}
+
+const std::vector<Glucose::Lit>* Propagator::DetectInconsistencyExpensive() {
+    int height = problem_.height();
+    int width = problem_.width();
+    MarkDirtyRegion(expensive_checkpoints_);
+
+    // shape finder
+    // Whether a shape can be placed depends on the potential unit of the shape and the adjacent ones
+    ++shape_check_epoch_;
+    if (shape_check_epoch_ == 0) {
+        std::fill(shape_check_mark_.begin(), shape_check_mark_.end(), 0);
+        std::fill(unit_checked_mark_.begin(), unit_checked_mark_.end(), 0);
+        shape_check_epoch_ = 1;
+    }
+    shape_check_potential_units_.clear();
+    auto add_shape_check = [&](int p) {
+        if (shape_check_mark_[p] != shape_check_epoch_) {
+            shape_check_mark_[p] = shape_check_epoch_;
+            shape_check_potential_units_.push_back(p);
+        }
+    };
+    for (int p : dirty_potential_units_) {
+        add_shape_check(p);
+        CollectAdjacentPotentialUnits(p);
+        for (int q : adjacent_potential_units_) {
+            add_shape_check(q);
         }
-        shape.Normalize();
+    }
+
+    Shape& shape = shape_;
+    std::vector<std::pair<int, int>>& origins = origins_;
+    const Bitboard* bitboard = board_.bitboard();
 
-        std::pair<int, int> one_cell = info.units.group(i)[0];
-        int potential_unit_id = info.potential_units.group_id(one_cell.first, one_cell.second);
-        for (int g : adjacent_potential_units[potential_unit_id]) {
-            for (auto p : info.potential_units.group(g)) {
+    for (int potential_unit_id : shape_check_potential_units_) {
+        CollectAdjacentPotentialUnits(potential_unit_id);
+        origins.clear();
+        for (int q : adjacent_potential_units_) {
+            for (auto p : board_.PotentialUnitCells(q)) {
                 origins.push_back(p);
             }
         }
 
-        EnumerateTransforms(shape, transforms);
-
-        bool found = false;
-        std::set<Glucose::Lit> blockers;
-        for (auto& tr : transforms) {
-            if (tr.cells.empty()) {
-                break;
+        // Units are always contained in a potential unit
+        for (auto [unit_y, unit_x] : board_.PotentialUnitCells(potential_unit_id)) {
+            int unit_id = board_.UnitId(unit_y, unit_x);
+            if (unit_checked_mark_[unit_id] == shape_check_epoch_) {
+                continue;
             }
-            auto& t_connections = tr.connections;
+            unit_checked_mark_[unit_id] = shape_check_epoch_;
 
-            for (auto [origin_y, origin_x] : origins) {
-                bool invalid = false;
-                std::optional<Glucose::Lit> blocker_cand;
-
-                for (auto [dy, dx] : t_connections) {
-                    int py = origin_y * 2 + dy;
-                    int px = origin_x * 2 + dx;
-
-                    if (!(0 <= py && py <= (height - 1) * 2 && 0 <= px && px <= (width - 1) * 2)) {
-                        invalid = true;
-                        blocker_cand = std::nullopt;
-                        break;
+            // Find the same shape (of the opposite color) in a neighboring potential unit
+            shape.clear();
+            for (auto [y, x] : board_.UnitCells(unit_y, unit_x)) {
+                if (y < height - 1 && board_.UnitId(y + 1, x) == unit_id) {
+                    shape.connections.push_back({y * 2 + 1, x * 2});
+                }
+                if (x < width - 1 && board_.UnitId(y, x + 1) == unit_id) {
+                    shape.connections.push_back({y * 2, x * 2 + 1});
+                }
+                shape.cells.push_back({y, x});
+            }
+            std::sort(shape.cells.begin(), shape.cells.end());
+            shape.Normalize();
+
+            const ShapeTransforms& transforms = transform_cache_.Get(shape);
+
+            bool found = false;
+            for (int t = 0; t < transforms.num_shapes && !found; ++t) {
+                for (auto [origin_y, origin_x] : origins) {
+                    bool can_place;
+                    if (bitboard != nullptr) {
+                        can_place =
+                            CanPlaceShapeByBitboard(*bitboard, transforms.connection_masks[t], origin_y, origin_x);
+                    } else {
+                        can_place =
+                            CanPlaceShape(problem_, board_, transforms.shapes[t].connections, origin_y, origin_x);
                     }
-                    if (problem_.color(py >> 1, px >> 1) != problem_.color((py + 1) >> 1, (px + 1) >> 1)) {
-                        invalid = true;
-                        blocker_cand = std::nullopt;
+
+                    if (can_place) {
+                        found = true;
                         break;
                     }
-                    if ((py & 1) == 1) {
-                        if (board_.vertical(py >> 1, px >> 1) == BoardManager::Border::kWall) {
-                            invalid = true;
-                            blocker_cand = Glucose::mkLit(board_.VerticalVar(py >> 1, px >> 1), false);
-                        }
-                    } else {
-                        if (board_.horizontal(py >> 1, px >> 1) == BoardManager::Border::kWall) {
-                            invalid = true;
-                            blocker_cand = Glucose::mkLit(board_.HorizontalVar(py >> 1, px >> 1), false);
-                        }
-                    }
                 }
+            }
 
-                if (!invalid) {
-                    found = true;
-                    break;
-                }
-                if (blocker_cand) {
-                    blockers.insert(*blocker_cand);
-                }
+            if (!found) {
+                ReasonForShapeFinder(unit_y, unit_x, potential_unit_id, transforms);
+                return &reason_;
             }
+        }
+    }
+
+    AddCheckpoint(expensive_checkpoints_);
+    return nullptr;
+}
 
-            if (found) {
+void Propagator::ClearWallMarks() {
+    ++wall_mark_epoch_;
+    if (wall_mark_epoch_ == 0) {
+        std::fill(wall_mark_.begin(), wall_mark_.end(), 0);
+        wall_mark_epoch_ = 1;
+    }
+}
+
+void Propagator::MarkWall(Glucose::Lit lit, std::vector<Glucose::Lit>& out) {
+    unsigned int& mark = wall_mark_[Glucose::var(lit) - origin_];
+    if (mark != wall_mark_epoch_) {
+        mark = wall_mark_epoch_;
+        out.push_back(lit);
+    }
+}
+
+Glucose::Var Propagator::WallAt(int py, int px) const {
+    if ((py & 1) == 1) {
+        if (board_.vertical(py >> 1, px >> 1) != BoardManager::Border::kWall) {
+            return -1;
+        }
+        return board_.VerticalVar(py >> 1, px >> 1);
+    } else {
+        if (board_.horizontal(py >> 1, px >> 1) != BoardManager::Border::kWall) {
+            return -1;
+        }
+        return board_.HorizontalVar(py >> 1, px >> 1);
+    }
+}
+
+bool Propagator::AddBlockerCandidate(const ShapeTransforms& transforms, int shape, int origin_y, int origin_x) {
+    Glucose::Var blocker = -1;
+    for (auto [dy, dx] : transforms.shapes[shape].connections) {
+        Glucose::Var var = WallAt(origin_y * 2 + dy, origin_x * 2 + dx);
+        // Walls decided earlier tend to be at lower decision levels, which makes learnt clauses shorter
+        if (var != -1 && (blocker == -1 || board_.DecisionIndex(var) < board_.DecisionIndex(blocker))) {
+            blocker = var;
+        }
+    }
+
+    if (blocker == -1) {
+        return false;
+    }
+    blocker_candidates_.push_back({blocker, origin_y, origin_x, shape});
+    return true;
+}
+
+bool Propagator::AddBlockers(const ShapeTransforms& transforms, std::vector<Glucose::Lit>& out, size_t limit) {
+    std::sort(blocker_candidates_.begin(), blocker_candidates_.end(),
+              [](const BlockerCandidate& a, const BlockerCandidate& b) {
+                  return std::tie(a.origin_y, a.origin_x, a.shape) < std::tie(b.origin_y, b.origin_x, b.shape);
+              });
+    for (const BlockerCandidate& c : blocker_candidates_) {
+        bool blocked = false;
+        for (auto [dy, dx] : transforms.shapes[c.shape].connections) {
+            Glucose::Var var = WallAt(c.origin_y * 2 + dy, c.origin_x * 2 + dx);
+            if (var != -1 && wall_mark_[var - origin_] == wall_mark_epoch_) {
+                blocked = true;
                 break;
             }
         }
+        if (blocked) {
+            continue;
+        }
+        if (out.size() + 1 >= limit) {
+            return false;
+        }
+        MarkWall(Glucose::mkLit(c.wall), out);
+    }
+    return true;
+}
 
-        if (!found) {
-            // TODO: compute more refined reason
-            std::set<Glucose::Lit> reason = blockers;
-            {
-                auto app = board_.ReasonForUnit(info, i);
-                reason.insert(app.begin(), app.end());
+void Propagator::ReasonForShapeFinder(int unit_y, int unit_x, int potential_unit_id,
+                                      const ShapeTransforms& transforms) {
+    int height = problem_.height();
+    int width = problem_.width();
+
+    // The unit is in the potential unit P (`potential_unit_id`), and the shape must be in a potential unit Q of the
+    // other color which is adjacent to P. Every placement of the shape is within a color region, so the reason is
+    // built for each color region K next to P from either
+    // (a) the walls between P and the cells of K not in any adjacent Q, the walls bounding the adjacent Qs in K, and
+    //     a wall blocking each placement in these Qs, or
+    // (b) a wall blocking each placement in K,
+    // whichever is shorter.
+    reason_.clear();
+    board_.ReasonForUnit(unit_y, unit_x, reason_);
+    board_.ReasonForPotentialUnitBoundary(potential_unit_id, reason_);
+
+    ++region_mark_epoch_;
+    if (region_mark_epoch_ == 0) {
+        std::fill(region_mark_.begin(), region_mark_.end(), 0);
+        region_mark_epoch_ = 1;
+    }
+    shape_regions_.clear();
+    // Calls `f(y, x, var)` for each border between P and a cell (y, x) of the other color
+    auto for_each_outer_border = [&](auto f) {
+        for (auto [y, x] : board_.PotentialUnitCells(potential_unit_id)) {
+            if (y > 0 && problem_.color(y, x) != problem_.color(y - 1, x)) {
+                f(y - 1, x, board_.VerticalVar(y - 1, x));
             }
-            {
-                auto app = board_.ReasonForPotentialUnitBoundary(info, potential_unit_id);
-                reason.insert(app.begin(), app.end());
+            if (y < height - 1 && problem_.color(y, x) != problem_.color(y + 1, x)) {
+                f(y + 1, x, board_.VerticalVar(y, x));
             }
-            for (int g : adjacent_potential_units[potential_unit_id]) {
-                auto app = board_.ReasonForPotentialUnitBoundary(info, g);
-                reason.insert(app.begin(), app.end());
+            if (x > 0 && problem_.color(y, x) != problem_.color(y, x - 1)) {
+                f(y, x - 1, board_.HorizontalVar(y, x - 1));
             }
-            for (auto [y, x] : info.potential_units.group(potential_unit_id)) {
-                if (y > 0 && board_.vertical(y - 1, x) == BoardManager::Border::kWall &&
-                    problem_.color(y, x) != problem_.color(y - 1, x) &&
-                    adjacent_potential_units_set.count({potential_unit_id, info.potential_units.group_id(y - 1, x)}) ==
-                        0) {
-                    reason.insert(Glucose::mkLit(board_.VerticalVar(y - 1, x)));
-                }
-                if (y < height - 1 && board_.vertical(y, x) == BoardManager::Border::kWall &&
-                    problem_.color(y, x) != problem_.color(y + 1, x) &&
-                    adjacent_potential_units_set.count({potential_unit_id, info.potential_units.group_id(y + 1, x)}) ==
-                        0) {
-                    reason.insert(Glucose::mkLit(board_.VerticalVar(y, x)));
-                }
-                if (x > 0 && board_.horizontal(y, x - 1) == BoardManager::Border::kWall &&
-                    problem_.color(y, x) != problem_.color(y, x - 1) &&
-                    adjacent_potential_units_set.count({potential_unit_id, info.potential_units.group_id(y, x - 1)}) ==
-                        0) {
-                    reason.insert(Glucose::mkLit(board_.HorizontalVar(y, x - 1)));
+            if (x < width - 1 && problem_.color(y, x) != problem_.color(y, x + 1)) {
+                f(y, x + 1, board_.HorizontalVar(y, x));
+            }
+        }
+    };
+    for_each_outer_border([&](int y, int x, Glucose::Var) {
+        int k = color_regions_.group_id(y, x);
+        if (region_mark_[k] != region_mark_epoch_) {
+            region_mark_[k] = region_mark_epoch_;
+            shape_regions_.push_back(k);
+        }
+    });
+
+    for (int k : shape_regions_) {
+        // (a)
+        ClearWallMarks();
+        blocker_candidates_.clear();
+        reason_cut_.clear();
+        for (int q : adjacent_potential_units_) {
+            auto [qy, qx] = *board_.PotentialUnitCells(q).begin();
+            if (color_regions_.group_id(qy, qx) != k) {
+                continue;
+            }
+            reason_boundary_.clear();
+            board_.ReasonForPotentialUnitBoundary(q, reason_boundary_);
+            for (Glucose::Lit lit : reason_boundary_) {
+                MarkWall(lit, reason_cut_);
+            }
+        }
+        for_each_outer_border([&](int y, int x, Glucose::Var var) {
+            if (color_regions_.group_id(y, x) == k &&
+                adjacent_mark_[board_.PotentialUnitId(y, x)] != adjacent_mark_epoch_) {
+                MarkWall(Glucose::mkLit(var), reason_cut_);
+            }
+        });
+        for (int q : adjacent_potential_units_) {
+            auto [qy, qx] = *board_.PotentialUnitCells(q).begin();
+            if (color_regions_.group_id(qy, qx) != k) {
+                continue;
+            }
+            for (auto [origin_y, origin_x] : board_.PotentialUnitCells(q)) {
+                for (int t = 0; t < transforms.num_shapes; ++t) {
+                    if (FitsColors(problem_, transforms.shapes[t].connections, origin_y, origin_x)) {
+                        [[maybe_unused]] bool has_wall = AddBlockerCandidate(transforms, t, origin_y, origin_x);
+                        assert(has_wall);
+                    }
                 }
-                if (x < width - 1 && board_.horizontal(y, x) == BoardManager::Border::kWall &&
-                    problem_.color(y, x) != problem_.color(y, x + 1) &&
-                    adjacent_potential_units_set.count({potential_unit_id, info.potential_units.group_id(y, x + 1)}) ==
-                        0) {
-                    reason.insert(Glucose::mkLit(board_.HorizontalVar(y, x)));
+            }
+        }
+        AddBlockers(transforms, reason_cut_, std::numeric_limits<size_t>::max());
+
+        // (b), which is abandoned as soon as it turns out to be infeasible or not shorter than (a)
+        ClearWallMarks();
+        blocker_candidates_.clear();
+        reason_blockers_.clear();
+        bool use_blockers = true;
+        for (auto [origin_y, origin_x] : color_regions_.group(k)) {
+            for (int t = 0; t < transforms.num_shapes && use_blockers; ++t) {
+                if (FitsColors(problem_, transforms.shapes[t].connections, origin_y, origin_x) &&
+                    !AddBlockerCandidate(transforms, t, origin_y, origin_x)) {
+                    use_blockers = false;
                 }
             }
-
-            return std::vector<Glucose::Lit>(reason.begin(), reason.end());
+            if (!use_blockers) {
+                break;
+            }
+        }
+        if (use_blockers) {
+            use_blockers = AddBlockers(transforms, reason_blockers_, reason_cut_.size());
         }
-    }
 
-    return std::nullopt;
+        const std::vector<Glucose::Lit>& app = use_blockers ? reason_blockers_ : reason_cut_;
+        reason_.insert(reason_.end(), app.begin(), app.end());
+    }
 }
 
 }
@@ -1,6 +1,6 @@
 #pragma once
 
-#include <optional>
+#include <vector>
 
 #include "core/Constraint.h"
 #include "core/Solver.h"
@@ -20,13 +20,95 @@ public:
     std::vector<Glucose::Var> RelatedVariables();
     void SimplePropagatorDecide(Glucose::Lit p);
     void SimplePropagatorUndo(Glucose::Lit p);
-    std::optional<std::vector<Glucose::Lit>> DetectInconsistency();
+    const std::vector<Glucose::Lit>* DetectInconsistency();
+    const std::vector<Glucose::Lit>* DetectInconsistencyExpensive();
 
 private:
+    // Marks the potential units and blocks which may have changed since the last checkpoint in `checkpoints` (all of
+    // them if there is no checkpoint), and stores them to `dirty_potential_units_` and `dirty_blocks_`.
+    void MarkDirtyRegion(const std::vector<int>& checkpoints);
+
+    // The clue number of the block `block_id` and one of the cells having it ({-1, {-1, -1}} if none), which is
+    // computed on the first call in each check
+    const std::pair<int, std::pair<int, int>>& BlockClue(int block_id);
+
+    // Stores the potential units of the other color adjacent to `potential_unit_id` through a non-wall border to
+    // `adjacent_potential_units_`, and marks them in `adjacent_mark_`
+    void CollectAdjacentPotentialUnits(int potential_unit_id);
+
+    // Records the current state as a checkpoint if no literal has been enqueued by the check just finished.
+    void AddCheckpoint(std::vector<int>& checkpoints);
+
+    // Computes to `reason_` the reason why the shape of the unit containing (unit_y, unit_x), whose potential unit is
+    // `potential_unit_id`, cannot be placed next to it. `adjacent_potential_units_` must be those of the failed search.
+    void ReasonForShapeFinder(int unit_y, int unit_x, int potential_unit_id, const ShapeTransforms& transforms);
+
+    // A placement of `transforms.shapes[shape]` at (origin_y, origin_x) to be blocked, and the earliest decided wall
+    // on its connections
+    struct BlockerCandidate {
+        Glucose::Var wall;
+        int origin_y, origin_x, shape;
+    };
+
+    // Appends the placement of `transforms.shapes[shape]` at (origin_y, origin_x) to `blocker_candidates_`. Returns
+    // false if there is no wall on its connections.
+    bool AddBlockerCandidate(const ShapeTransforms& transforms, int shape, int origin_y, int origin_x);
+
+    // Adds to `out` walls blocking all placements in `blocker_candidates_`. The placements are visited in the order of
+    // their origins (row-major, then by shape), and each one not blocked by a marked wall yet gets its earliest wall
+    // marked, so the result depends only on the set of placements, not on the order of the cell lists they come from.
+    // Returns false as soon as `out` would have `limit` literals or more.
+    bool AddBlockers(const ShapeTransforms& transforms, std::vector<Glucose::Lit>& out, size_t limit);
+
+    // Returns the variable of the border at (py, px) in the doubled coordinates if it is a wall, or -1 otherwise
+    Glucose::Var WallAt(int py, int px) const;
+
+    // Starts a new set of marked walls for `AddBlockers`
+    void ClearWallMarks();
+    void MarkWall(Glucose::Lit lit, std::vector<Glucose::Lit>& out);
+
     Problem problem_;
     BoardManager board_;
+    Glucose::Var origin_;
     std::vector<std::vector<Glucose::Lit>> reasons_;
-    std::vector<Shape> transforms_;
+    ShapeTransformCache transform_cache_;
+
+    // Connected components of cells of the same color regardless of borders. A unit and the shape found for it are
+    // always in a single component.
+    GroupInfo color_regions_;
+
+    // Dirty region tracking. A checkpoint is the number of decisions at a check of the tier which found neither an
+    // inconsistency nor a new implication. Components not touched by later decisions are the same as at that time, so
+    // they need not be checked again.
+    std::vector<int> cheap_checkpoints_, expensive_checkpoints_;
+
+    // Work area for `DetectInconsistency`, which is kept across calls so that no allocation happens in steady state.
+    // Components are identified by the ids of `BoardManager` (below `height * width`), and a mark is set iff it is
+    // equal to the corresponding epoch, so that nothing proportional to the board size is done for each check.
+    std::vector<int> dirty_cells_;
+    std::vector<unsigned int> dirty_potential_unit_, dirty_block_;
+    unsigned int dirty_epoch_;
+    std::vector<int> dirty_potential_units_, dirty_blocks_;
+    std::vector<std::pair<int, std::pair<int, int>>> block_clue_; // valid if `block_clue_mark_` is `dirty_epoch_`
+    std::vector<unsigned int> block_clue_mark_;
+    std::vector<int> shape_check_potential_units_;
+    std::vector<unsigned int> shape_check_mark_, unit_checked_mark_;
+    unsigned int shape_check_epoch_;
+    std::vector<int> adjacent_potential_units_;
+    std::vector<unsigned int> adjacent_mark_;
+    unsigned int adjacent_mark_epoch_;
+    Shape shape_;
+    std::vector<std::pair<int, int>> origins_;
+    std::vector<Glucose::Lit> reason_; // the reason returned by `DetectInconsistency` / `DetectInconsistencyExpensive`
+
+    // Work area for `ReasonForShapeFinder`
+    std::vector<int> shape_regions_;
+    std::vector<unsigned int> region_mark_;
+    unsigned int region_mark_epoch_;
+    std::vector<unsigned int> wall_mark_; // indexed by variable - `origin_`
+    unsigned int wall_mark_epoch_;
+    std::vector<Glucose::Lit> reason_cut_, reason_blockers_, reason_boundary_;
+    std::vector<BlockerCandidate> blocker_candidates_;
 };
 
 }
@@ -0,0 +1,64 @@
+#include "doublechoco/RollbackUnionFind.h"
+
+#include <cassert>
+#include <utility>
+
+namespace doublechoco {
+
+RollbackUnionFind::RollbackUnionFind(const std::vector<int>& color)
+    : parent_(color.size()), rank_(color.size(), 0), next_(color.size()), color_count_(color.size(), {0, 0}) {
+    for (int i = 0; i < color.size(); ++i) {
+        parent_[i] = i;
+        next_[i] = i;
+        color_count_[i][color[i]] = 1;
+    }
+    // `Union` is called at most once for each border, and there are less than twice as many borders as elements
+    history_.reserve(color.size() * 2);
+}
+
+bool RollbackUnionFind::Union(int p, int q) {
+    p = Root(p);
+    q = Root(q);
+
+    if (p == q) {
+        history_.push_back({-1, false});
+        return false;
+    }
+
+    if (rank_[p] < rank_[q]) {
+        std::swap(p, q);
+    }
+    bool rank_increased = rank_[p] == rank_[q];
+    if (rank_increased) {
+        ++rank_[p];
+    }
+    parent_[q] = p;
+    // Swapping the successors of elements of two different cycles joins them, and swapping again splits them
+    std::swap(next_[p], next_[q]);
+    color_count_[p][0] += color_count_[q][0];
+    color_count_[p][1] += color_count_[q][1];
+    history_.push_back({q, rank_increased});
+    return true;
+}
+
+void RollbackUnionFind::Rollback() {
+    assert(!history_.empty());
+    History h = history_.back();
+    history_.pop_back();
+
+    if (h.child == -1) {
+        return;
+    }
+
+    int q = h.child;
+    int p = parent_[q];
+    parent_[q] = q;
+    std::swap(next_[p], next_[q]);
+    color_count_[p][0] -= color_count_[q][0];
+    color_count_[p][1] -= color_count_[q][1];
+    if (h.rank_increased) {
+        --rank_[p];
+    }
+}
+
+}
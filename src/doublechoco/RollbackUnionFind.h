@@ -0,0 +1,51 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+namespace doublechoco {
+
+// Union-find which supports undoing the most recent `Union` operation.
+// Union by rank is used and path compression is not, so that every operation can be undone in O(1) and `Root` is
+// O(log n). Each element has a color (0 or 1) and the number of elements of each color is maintained for every set.
+// The elements of each set also form a cyclic list (see `Next`), so that a set can be enumerated in O(its size).
+class RollbackUnionFind {
+public:
+    RollbackUnionFind(const std::vector<int>& color);
+
+    int Root(int p) const {
+        while (parent_[p] != p) {
+            p = parent_[p];
+        }
+        return p;
+    }
+
+    // Merges the sets containing `p` and `q`. Returns whether they were different sets.
+    // Exactly one history entry is recorded for each call, even if `p` and `q` are already in the same set.
+    bool Union(int p, int q);
+
+    // Undoes the most recent `Union` which is not undone yet.
+    void Rollback();
+
+    int Size(int p) const {
+        p = Root(p);
+        return color_count_[p][0] + color_count_[p][1];
+    }
+    int ColorCount(int p, int c) const { return color_count_[Root(p)][c]; }
+
+    // The element following `p` in the cyclic list of the set containing `p`
+    int Next(int p) const { return next_[p]; }
+    const std::vector<int>& next() const { return next_; }
+
+private:
+    struct History {
+        int child;            // the root which was attached to another root (-1 if no merge happened)
+        bool rank_increased;
+    };
+
+    std::vector<int> parent_, rank_, next_;
+    std::vector<std::array<int, 2>> color_count_;
+    std::vector<History> history_;
+};
+
+}
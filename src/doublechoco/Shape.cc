@@ -1,9 +1,75 @@
 #include "doublechoco/Shape.h"
 
 #include <cassert>
+#include <limits>
 
 namespace doublechoco {
 
+namespace {
+
+uint64_t MixHash(uint64_t x) {
+    // splitmix64 finalizer
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+uint64_t CellHash(int y, int x) { return MixHash((static_cast<uint64_t>(y) << 32) | static_cast<uint32_t>(x)); }
+
+// Stores the distinct transforms of `shape` (including `shape` itself) to the beginning of `ret`, and returns the
+// number of them. `ret` has at least 8 elements after the call, and the storage of the elements is reused.
+int EnumerateTransforms(const Shape& shape, std::vector<Shape>& ret) {
+    if (ret.size() < 8) {
+        ret.resize(8);
+    }
+    ret[0] = shape;
+    int num = 1;
+
+    ret[0].Rotate180To(ret[1]);
+    if (!(ret[0] == ret[1])) {
+        num = 2;
+    }
+
+    {
+        for (int i = 0; i < num; ++i) {
+            ret[i].Rotate90To(ret[i + num]);
+        }
+        bool is_unique = true;
+        for (int i = 0; i < num; ++i) {
+            if (ret[i] == ret[num]) {
+                is_unique = false;
+                break;
+            }
+        }
+        if (is_unique) {
+            num *= 2;
+        }
+    }
+
+    {
+        for (int i = 0; i < num; ++i) {
+            ret[i].FlipYTo(ret[i + num]);
+        }
+        bool is_unique = true;
+        for (int i = 0; i < num; ++i) {
+            if (ret[i] == ret[num]) {
+                is_unique = false;
+                break;
+            }
+        }
+        if (is_unique) {
+            num *= 2;
+        }
+    }
+
+    return num;
+}
+
+} // namespace
+
 void Shape::clear() {
     cells.clear();
     connections.clear();
@@ -66,4 +132,194 @@ void Shape::Normalize() {
 
 bool Shape::operator==(const Shape& rhs) const { return cells == rhs.cells; }
 
+uint64_t Shape::CanonicalHash() const {
+    int y_min = cells[0].first, y_max = cells[0].first;
+    int x_min = cells[0].second, x_max = cells[0].second;
+    for (auto& [y, x] : cells) {
+        y_min = std::min(y_min, y);
+        y_max = std::max(y_max, y);
+        x_min = std::min(x_min, x);
+        x_max = std::max(x_max, x);
+    }
+    int h = y_max - y_min;
+    int w = x_max - x_min;
+
+    // Each transform maps the bounding box onto [0, h] x [0, w] or [0, w] x [0, h]. Since the cell hashes are summed
+    // up, the hash of a transform does not depend on the order of cells, and the minimum over all transforms is
+    // invariant.
+    uint64_t hash[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    for (auto& [y, x] : cells) {
+        int dy = y - y_min;
+        int dx = x - x_min;
+        hash[0] += CellHash(dy, dx);
+        hash[1] += CellHash(dy, w - dx);
+        hash[2] += CellHash(h - dy, dx);
+        hash[3] += CellHash(h - dy, w - dx);
+        hash[4] += CellHash(dx, dy);
+        hash[5] += CellHash(dx, h - dy);
+        hash[6] += CellHash(w - dx, dy);
+        hash[7] += CellHash(w - dx, h - dy);
+    }
+    return MixHash(*std::min_element(hash, hash + 8) + cells.size());
+}
+
+ShapeConnectionMasks::ShapeConnectionMasks(const Shape& shape) { Assign(shape); }
+
+void ShapeConnectionMasks::Assign(const Shape& shape) {
+    row_min = col_min = 0;
+    row_max = col_max = -1;
+    horizontal.clear();
+    vertical.clear();
+    if (shape.connections.empty()) {
+        return;
+    }
+    row_min = col_min = std::numeric_limits<int>::max();
+    row_max = col_max = std::numeric_limits<int>::min();
+    for (auto& [y, x] : shape.connections) {
+        // arithmetic shift, so that negative coordinates are rounded down
+        row_min = std::min(row_min, y >> 1);
+        row_max = std::max(row_max, y >> 1);
+        col_min = std::min(col_min, x >> 1);
+        col_max = std::max(col_max, x >> 1);
+    }
+    if (col_max - col_min + 1 > kMaxSpan) {
+        return;
+    }
+
+    horizontal.assign(row_max - row_min + 1, 0);
+    vertical.assign(row_max - row_min + 1, 0);
+    for (auto& [y, x] : shape.connections) {
+        uint64_t bit = 1ULL << ((x >> 1) - col_min);
+        if ((y & 1) == 1) {
+            vertical[(y >> 1) - row_min] |= bit;
+        } else {
+            horizontal[(y >> 1) - row_min] |= bit;
+        }
+    }
+}
+
+ShapeTransformCache::ShapeTransformCache(int max_cells) : table_(kTableSize, -1) {
+    entries_.reserve(kMaxEntries);
+    shapes_.reserve(kMaxEntries * 8);
+    cells_.reserve(kPoolSize);
+    connections_.reserve(kPoolSize);
+    masks_.reserve(kPoolSize);
+
+    // A shape of `max_cells` cells has less than `max_cells * 2` connections in at most `max_cells` rows
+    transforms_.shapes.resize(8);
+    transforms_.connection_masks.resize(8);
+    for (int i = 0; i < 8; ++i) {
+        transforms_.shapes[i].cells.reserve(max_cells);
+        transforms_.shapes[i].connections.reserve(max_cells * 2);
+        transforms_.connection_masks[i].horizontal.reserve(max_cells);
+        transforms_.connection_masks[i].vertical.reserve(max_cells);
+    }
+}
+
+const ShapeTransforms& ShapeTransformCache::Get(const Shape& shape) {
+    uint64_t key = shape.CanonicalHash();
+    if (Find(shape, key)) {
+        return transforms_;
+    }
+
+    transforms_.num_shapes = EnumerateTransforms(shape, transforms_.shapes);
+    for (int i = 0; i < transforms_.num_shapes; ++i) {
+        transforms_.connection_masks[i].Assign(transforms_.shapes[i]);
+    }
+    Store(key);
+    return transforms_;
+}
+
+bool ShapeTransformCache::Find(const Shape& shape, uint64_t key) {
+    for (int idx = key & (kTableSize - 1); table_[idx] != -1; idx = (idx + 1) & (kTableSize - 1)) {
+        const Entry& entry = entries_[table_[idx]];
+        if (entry.key != key) {
+            continue;
+        }
+        bool found = false;
+        for (int i = entry.shapes_begin; i < entry.shapes_end && !found; ++i) {
+            const StoredShape& s = shapes_[i];
+            found = s.cells_end - s.cells_begin == (int)shape.cells.size() &&
+                    std::equal(shape.cells.begin(), shape.cells.end(), cells_.begin() + s.cells_begin);
+        }
+        if (!found) {
+            continue;
+        }
+
+        transforms_.num_shapes = entry.shapes_end - entry.shapes_begin;
+        for (int i = 0; i < transforms_.num_shapes; ++i) {
+            const StoredShape& s = shapes_[entry.shapes_begin + i];
+            Shape& dest = transforms_.shapes[i];
+            dest.cells.assign(cells_.begin() + s.cells_begin, cells_.begin() + s.cells_end);
+            dest.connections.assign(connections_.begin() + s.connections_begin,
+                                    connections_.begin() + s.connections_end);
+
+            ShapeConnectionMasks& masks = transforms_.connection_masks[i];
+            masks.row_min = s.row_min;
+            masks.row_max = s.row_max;
+            masks.col_min = s.col_min;
+            masks.col_max = s.col_max;
+            int num_rows = (s.masks_end - s.masks_begin) / 2;
+            masks.horizontal.assign(masks_.begin() + s.masks_begin, masks_.begin() + s.masks_begin + num_rows);
+            masks.vertical.assign(masks_.begin() + s.masks_begin + num_rows, masks_.begin() + s.masks_end);
+        }
+        return true;
+    }
+    return false;
+}
+
+void ShapeTransformCache::Store(uint64_t key) {
+    size_t num_cells = 0, num_connections = 0, num_masks = 0;
+    for (int i = 0; i < transforms_.num_shapes; ++i) {
+        num_cells += transforms_.shapes[i].cells.size();
+        num_connections += transforms_.shapes[i].connections.size();
+        num_masks += transforms_.connection_masks[i].horizontal.size() * 2;
+    }
+    if (num_cells > kPoolSize || num_connections > kPoolSize || num_masks > kPoolSize) {
+        // too large to be cached
+        return;
+    }
+    if (entries_.size() == kMaxEntries || cells_.size() + num_cells > kPoolSize ||
+        connections_.size() + num_connections > kPoolSize || masks_.size() + num_masks > kPoolSize) {
+        Clear();
+    }
+
+    int idx = key & (kTableSize - 1);
+    while (table_[idx] != -1) {
+        idx = (idx + 1) & (kTableSize - 1);
+    }
+    table_[idx] = entries_.size();
+    entries_.push_back({key, (int)shapes_.size(), (int)shapes_.size() + transforms_.num_shapes});
+
+    for (int i = 0; i < transforms_.num_shapes; ++i) {
+        const Shape& shape = transforms_.shapes[i];
+        const ShapeConnectionMasks& masks = transforms_.connection_masks[i];
+        StoredShape s;
+        s.cells_begin = cells_.size();
+        cells_.insert(cells_.end(), shape.cells.begin(), shape.cells.end());
+        s.cells_end = cells_.size();
+        s.connections_begin = connections_.size();
+        connections_.insert(connections_.end(), shape.connections.begin(), shape.connections.end());
+        s.connections_end = connections_.size();
+        s.row_min = masks.row_min;
+        s.row_max = masks.row_max;
+        s.col_min = masks.col_min;
+        s.col_max = masks.col_max;
+        s.masks_begin = masks_.size();
+        masks_.insert(masks_.end(), masks.horizontal.begin(), masks.horizontal.end());
+        masks_.insert(masks_.end(), masks.vertical.begin(), masks.vertical.end());
+        s.masks_end = masks_.size();
+        shapes_.push_back(s);
+    }
+}
+
+void ShapeTransformCache::Clear() {
+    std::fill(table_.begin(), table_.end(), -1);
+    entries_.clear();
+    shapes_.clear();
+    cells_.clear();
+    connections_.clear();
+    masks_.clear();
+}
+
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <algorithm>
+#include <cstdint>
 #include <vector>
 
 namespace doublechoco {
@@ -17,6 +18,79 @@ struct Shape {
     void Normalize();
 
     bool operator==(const Shape& rhs) const;
+
+    // Hash value of `cells` which is invariant under rotations and flips
+    uint64_t CanonicalHash() const;
+};
+
+// Connections of a shape as a bitmask for each row. A horizontal connection (2y, 2x + 1) is bit (x - col_min) of
+// `horizontal[y - row_min]`, and a vertical connection (2y + 1, 2x) is bit (x - col_min) of `vertical[y - row_min]`.
+struct ShapeConnectionMasks {
+    static constexpr int kMaxSpan = 64;
+
+    int row_min = 0, row_max = -1, col_min = 0, col_max = -1;
+    std::vector<uint64_t> horizontal, vertical; // empty if there are no connections or the span exceeds `kMaxSpan`
+
+    ShapeConnectionMasks() = default;
+    explicit ShapeConnectionMasks(const Shape& shape);
+
+    // Recomputes the masks for `shape`, reusing the storage
+    void Assign(const Shape& shape);
+};
+
+struct ShapeTransforms {
+    // Only the first `num_shapes` elements of `shapes` and `connection_masks` are valid. The others are kept so that
+    // their storage can be reused.
+    int num_shapes = 0;
+    std::vector<Shape> shapes;
+    std::vector<ShapeConnectionMasks> connection_masks; // `connection_masks[i]` corresponds to `shapes[i]`
+};
+
+// Cache from shapes to their distinct transforms (rotations and flips).
+// Shapes which are equal up to transforms share the same entry.
+//
+// Entries are stored in pools reserved on construction, and all entries are dropped when a pool is full, so that no
+// allocation happens in `Get`.
+class ShapeTransformCache {
+public:
+    // `max_cells` is the maximum number of cells of the shapes passed to `Get`.
+    explicit ShapeTransformCache(int max_cells);
+
+    // Returns the distinct transforms of `shape`, which must be normalized. `shape` itself is one of them.
+    // The returned reference is valid until the next call.
+    const ShapeTransforms& Get(const Shape& shape);
+
+private:
+    static constexpr int kMaxEntries = 1 << 13;
+    static constexpr int kTableSize = kMaxEntries * 2; // power of two
+    static constexpr int kPoolSize = 1 << 17;
+
+    // A transform in the pools, whose cells are `cells_[cells_begin, cells_end)` and so on
+    struct StoredShape {
+        int cells_begin, cells_end;
+        int connections_begin, connections_end;
+        int row_min, row_max, col_min, col_max;
+        int masks_begin, masks_end; // horizontal masks followed by vertical ones
+    };
+    struct Entry {
+        uint64_t key;
+        int shapes_begin, shapes_end;
+    };
+
+    // Returns whether `shape` is in the entries under `key`. If so, its transforms are copied to `transforms_`.
+    bool Find(const Shape& shape, uint64_t key);
+    // Stores `transforms_` as an entry under `key`
+    void Store(uint64_t key);
+    void Clear();
+
+    std::vector<int> table_; // index in `entries_` or -1, with linear probing
+    std::vector<Entry> entries_;
+    std::vector<StoredShape> shapes_;
+    std::vector<std::pair<int, int>> cells_, connections_;
+    std::vector<uint64_t> masks_;
+
+    // The transforms returned by `Get`
+    ShapeTransforms transforms_;
 };
 
 }
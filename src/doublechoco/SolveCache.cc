@@ -0,0 +1,133 @@
+#include "doublechoco/SolveCache.h"
+
+#include <algorithm>
+#include <optional>
+#include <utility>
+
+namespace doublechoco {
+
+namespace {
+
+// Index of the border between adjacent cells `a` and `b` of a board of `height` x `width`, in the same order as the
+// variables of `BoardManager`
+int BorderIndex(int height, int width, std::pair<int, int> a, std::pair<int, int> b) {
+    if (a.first == b.first) {
+        return a.first * (width - 1) + std::min(a.second, b.second);
+    } else {
+        return height * (width - 1) + std::min(a.first, b.first) * width + a.second;
+    }
+}
+
+// Calls `f(border, canonical_index)` for each border of `answer`, where `canonical_index` is the index of the border in
+// the canonical orientation
+template <typename Answer, typename F>
+void ForEachBorder(int height, int width, const GridTransform& transform, Answer& answer, F f) {
+    int canonical_height = transform.transformed_height();
+    int canonical_width = transform.transformed_width();
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width - 1; ++x) {
+            f(answer.horizontal[y][x], BorderIndex(canonical_height, canonical_width, transform.Apply(y, x),
+                                                   transform.Apply(y, x + 1)));
+        }
+    }
+    for (int y = 0; y < height - 1; ++y) {
+        for (int x = 0; x < width; ++x) {
+            f(answer.vertical[y][x], BorderIndex(canonical_height, canonical_width, transform.Apply(y, x),
+                                                 transform.Apply(y + 1, x)));
+        }
+    }
+}
+
+// A cached result is "-" for no answer, and otherwise the borders in the canonical orientation: '1' for walls, '0' for
+// connected borders and '?' for undecided ones.
+std::string EncodeResult(const Problem& problem, const GridTransform& transform, const SolveResult& result) {
+    if (result.status == SolveResult::kNoAnswer) {
+        return "-";
+    }
+    int height = problem.height();
+    int width = problem.width();
+    std::string ret(height * (width - 1) + (height - 1) * width, '?');
+    ForEachBorder(height, width, transform, *result.answer, [&](DoublechocoAnswer::Border b, int idx) {
+        ret[idx] = b == DoublechocoAnswer::kWall ? '1' : b == DoublechocoAnswer::kConnected ? '0' : '?';
+    });
+    return ret;
+}
+
+// Returns std::nullopt if `value` is not a valid result for `problem` (e.g. a corrupted store), which is treated as a
+// cache miss.
+std::optional<SolveResult> DecodeResult(const Problem& problem, const GridTransform& transform,
+                                        const std::string& value) {
+    SolveResult ret;
+    if (value == "-") {
+        ret.status = SolveResult::kNoAnswer;
+        return ret;
+    }
+    int height = problem.height();
+    int width = problem.width();
+    if ((int)value.size() != height * (width - 1) + (height - 1) * width) {
+        return std::nullopt;
+    }
+    DoublechocoAnswer answer;
+    answer.horizontal.assign(height, std::vector<DoublechocoAnswer::Border>(width - 1));
+    answer.vertical.assign(height - 1, std::vector<DoublechocoAnswer::Border>(width));
+    ForEachBorder(height, width, transform, answer, [&](DoublechocoAnswer::Border& b, int idx) {
+        b = value[idx] == '1' ? DoublechocoAnswer::kWall
+            : value[idx] == '0' ? DoublechocoAnswer::kConnected
+                                : DoublechocoAnswer::kUndecided;
+    });
+    ret.status = SolveResult::kSolved;
+    ret.answer = std::move(answer);
+    return ret;
+}
+
+} // namespace
+
+CanonicalForm Canonicalize(const Problem& problem) {
+    int height = problem.height();
+    int width = problem.width();
+
+    std::optional<CanonicalForm> ret;
+    for (int t = 0; t < GridTransform::kNumTransforms; ++t) {
+        GridTransform transform(height, width, t);
+        int canonical_height = transform.transformed_height();
+        int canonical_width = transform.transformed_width();
+
+        // (color, number) of each cell in the canonical orientation
+        std::vector<std::pair<int, int>> cells(height * width);
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                auto [y2, x2] = transform.Apply(y, x);
+                cells[y2 * canonical_width + x2] = {problem.color(y, x), problem.num(y, x)};
+            }
+        }
+
+        std::string key = "dbchoco/" + std::to_string(canonical_height) + "/" + std::to_string(canonical_width) + "/";
+        for (auto [color, num] : cells) {
+            key += std::to_string(color) + ":" + std::to_string(num) + ",";
+        }
+        if (!ret || key < ret->key) {
+            ret = CanonicalForm{std::move(key), transform};
+        }
+    }
+    return *ret;
+}
+
+SolveResult SolveCached(const Problem& problem, ResultCache& cache, const SolveBudget& budget,
+                        const SolverOptions& options) {
+    CanonicalForm canonical = Canonicalize(problem);
+    std::optional<std::string> cached = cache.Get(canonical.key);
+    if (cached) {
+        std::optional<SolveResult> decoded = DecodeResult(problem, canonical.transform, *cached);
+        if (decoded) {
+            return *decoded;
+        }
+    }
+
+    SolveResult ret = SolveLimited(problem, budget, options);
+    if (ret.status != SolveResult::kUnknown) {
+        cache.Put(canonical.key, EncodeResult(problem, canonical.transform, ret));
+    }
+    return ret;
+}
+
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+
+#include "Budget.h"
+#include "GridTransform.h"
+#include "ResultCache.h"
+#include "doublechoco/Problem.h"
+#include "doublechoco/Solver.h"
+
+namespace doublechoco {
+
+struct CanonicalForm {
+    // Colors and numbers of the problem in the canonical orientation, which is the same for all problems equal up to
+    // rotations and reflections
+    std::string key;
+    // From the problem to the canonical orientation
+    GridTransform transform;
+};
+
+CanonicalForm Canonicalize(const Problem& problem);
+
+// Same as `SolveLimited`, but answers from `cache` if the same problem up to rotations and reflections is already
+// solved. Completed results are stored in `cache` in the canonical orientation and transformed back on lookup.
+SolveResult SolveCached(const Problem& problem, ResultCache& cache, const SolveBudget& budget = SolveBudget(),
+                        const SolverOptions& options = SolverOptions());
+
+}
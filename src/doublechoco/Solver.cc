@@ -1,11 +1,16 @@
 #include "doublechoco/Solver.h"
 
+#include <algorithm>
+#include <cassert>
 #include <memory>
-
-#include <map>
+#include <utility>
 
 #include "core/Solver.h"
 
+#include "Backbone.h"
+#include "Grid.h"
+#include "Portfolio.h"
+
 #include "doublechoco/Balancer.h"
 #include "doublechoco/BoardManager.h"
 #include "doublechoco/Propagator.h"
@@ -26,13 +31,26 @@ DoublechocoAnswer::Border ConvertBorder(BoardManager::Border b) {
     abort();
 }
 
-void AddConstraints(const Problem& problem, Glucose::Solver& solver, Glucose::Var origin) {
+// Returns the added `Propagator`, which is owned by `solver`. The propagator interrupts `solver` when `budget` is
+// exceeded, and reports the search counters to `progress` if it is not null.
+Propagator* AddConstraints(const Problem& problem, const SolverOptions& options, const BudgetTracker& budget,
+                           ProgressReporter* progress, Glucose::Solver& solver, Glucose::Var origin) {
     int height = problem.height();
     int width = problem.width();
 
-    solver.addConstraint(std::make_unique<Propagator>(problem, origin));
-    // TODO: Balancer is unused because it makes the solver slow
-    // solver.addConstraint(std::make_unique<Balancer>(problem, origin));
+    auto propagator = std::make_unique<Propagator>(problem, origin);
+    propagator->SetExpensiveTierSchedule(options.shape_finder_schedule);
+    if (budget.IsLimited()) {
+        propagator->SetBudget(&budget);
+    }
+    if (progress != nullptr) {
+        propagator->SetProgress(progress);
+    }
+    Propagator* ret = propagator.get();
+    solver.addConstraint(std::move(propagator));
+    if (options.use_balancer) {
+        solver.addConstraint(std::make_unique<Balancer>(problem, origin));
+    }
 
     // Rough check to forbid unnecessary borders
     for (int y = 0; y < height - 1; ++y) {
@@ -52,29 +70,17 @@ void AddConstraints(const Problem& problem, Glucose::Solver& solver, Glucose::Va
             }
         }
     }
-}
 
-} // namespace
-
-std::optional<DoublechocoAnswer> FindAnswer(const Problem& problem) {
-    Glucose::Solver solver;
-    Glucose::Var origin = BoardManager::AllocateVariables(solver, problem.height(), problem.width());
-
-    AddConstraints(problem, solver, origin);
-
-    if (!solver.solve())
-        return std::nullopt;
+    return ret;
+}
 
+DoublechocoAnswer AnswerFromBoard(const BoardManager& board) {
     DoublechocoAnswer ret;
-    int height = problem.height();
-    int width = problem.width();
+    int height = board.height();
+    int width = board.width();
     ret.horizontal = std::vector<std::vector<DoublechocoAnswer::Border>>(height);
     ret.vertical = std::vector<std::vector<DoublechocoAnswer::Border>>(height - 1);
 
-    BoardManager board(problem, origin);
-    for (Glucose::Var v : board.RelatedVariables()) {
-        board.Decide(Glucose::mkLit(v, solver.modelValue(v) == l_False));
-    }
     for (int y = 0; y < height; ++y) {
         for (int x = 0; x < width - 1; ++x) {
             ret.horizontal[y].push_back(ConvertBorder(board.horizontal(y, x)));
@@ -85,68 +91,301 @@ std::optional<DoublechocoAnswer> FindAnswer(const Problem& problem) {
             ret.vertical[y].push_back(ConvertBorder(board.vertical(y, x)));
         }
     }
-
     return ret;
 }
 
-std::optional<DoublechocoAnswer> Solve(const Problem& problem) {
-    Glucose::Solver solver;
-    Glucose::Var origin = BoardManager::AllocateVariables(solver, problem.height(), problem.width());
+// Converts the current model of `solver` into an answer without undecided borders
+DoublechocoAnswer AnswerFromModel(const Problem& problem, Glucose::Var origin, const Glucose::Solver& solver) {
+    BoardManager board(problem, origin);
+    for (Glucose::Var v : board.RelatedVariables()) {
+        board.Decide(Glucose::mkLit(v, solver.modelValue(v) == l_False));
+    }
+    return AnswerFromBoard(board);
+}
 
-    AddConstraints(problem, solver, origin);
+// A solver set up for a problem
+struct SolverInstance {
+    std::unique_ptr<Glucose::Solver> solver;
+    Glucose::Var origin;
+    Propagator* propagator; // owned by `solver`
+};
 
-    if (!solver.solve()) {
-        return std::nullopt;
+// Returns the reporter for `options.progress`, or null if it is not set
+std::unique_ptr<ProgressReporter> CreateProgressReporter(const SolverOptions& options) {
+    if (!options.progress) {
+        return nullptr;
     }
+    return std::make_unique<ProgressReporter>(options.progress, options.progress_interval_ms);
+}
 
-    BoardManager board(problem, origin);
-    std::vector<Glucose::Var> related_vars = board.RelatedVariables();
+// Passes the progress of the backbone computation to `progress` (if not null), and each proven border to
+// `options.on_border` (if set)
+class BackboneListener : public BackboneObserver {
+public:
+    BackboneListener(const Problem& problem, Glucose::Var origin, const SolverOptions& options,
+                     ProgressReporter* progress)
+        : height_(problem.height()), width_(problem.width()), origin_(origin), on_border_(options.on_border),
+          progress_(progress) {}
 
-    std::map<Glucose::Var, bool> assignment;
-    for (auto v : related_vars) {
-        assignment.emplace(v, solver.modelValue(v) == l_True);
+    void OnProgress(int num_candidates, int num_proven) override {
+        if (progress_ != nullptr) {
+            progress_->OnProgress(num_candidates, num_proven);
+        }
     }
 
-    for (;;) {
-        Glucose::vec<Glucose::Lit> refutation;
-        for (auto [var, val] : assignment) {
-            refutation.push(Glucose::mkLit(var, val));
-        }
-        solver.addClause(refutation);
+    // Positive literals are walls (see `BoardManager::Decide`)
+    void OnProven(Glucose::Lit lit) override {
+        Report(Glucose::var(lit),
+               Glucose::sign(lit) ? DoublechocoAnswer::Border::kConnected : DoublechocoAnswer::Border::kWall);
+    }
+    void OnRefuted(Glucose::Lit lit) override { Report(Glucose::var(lit), DoublechocoAnswer::Border::kUndecided); }
 
-        if (!solver.solve()) {
-            break;
+private:
+    void Report(Glucose::Var v, DoublechocoAnswer::Border border) {
+        if (!on_border_) {
+            return;
         }
-        for (auto it = assignment.begin(); it != assignment.end();) {
-            if ((solver.modelValue(it->first) == l_True) != it->second) {
-                it = assignment.erase(it);
-            } else {
-                ++it;
-            }
+        int ofs = v - origin_;
+        BorderDeduction deduction;
+        if (ofs < height_ * (width_ - 1)) {
+            deduction.is_horizontal = true;
+            deduction.y = ofs / (width_ - 1);
+            deduction.x = ofs % (width_ - 1);
+        } else {
+            ofs -= height_ * (width_ - 1);
+            deduction.is_horizontal = false;
+            deduction.y = ofs / width_;
+            deduction.x = ofs % width_;
         }
+        deduction.border = border;
+        on_border_(deduction);
     }
 
-    for (auto [var, val] : assignment) {
-        board.Decide(Glucose::mkLit(var, !val));
+    int height_, width_;
+    Glucose::Var origin_;
+    const std::function<void(const BorderDeduction&)>& on_border_;
+    ProgressReporter* progress_;
+};
+
+// Called at the end of a call
+void CollectStats(const SolverOptions& options, const SolverInstance& instance, ProgressReporter* progress) {
+    if (options.propagator_stats != nullptr) {
+        options.propagator_stats->Merge(instance.propagator->stats());
+    }
+    if (options.search_stats != nullptr) {
+        options.search_stats->Add(*instance.solver);
     }
+    if (progress != nullptr) {
+        progress->Flush();
+    }
+}
 
-    DoublechocoAnswer ret;
+SolverInstance CreateSolver(const Problem& problem, const SolverOptions& options, const BudgetTracker& budget,
+                            ProgressReporter* progress) {
+    SolverInstance ret;
+    ret.solver = std::make_unique<Glucose::Solver>();
+    ret.origin = BoardManager::AllocateVariables(*ret.solver, problem.height(), problem.width());
+    ret.propagator = AddConstraints(problem, options, budget, progress, *ret.solver, ret.origin);
+    return ret;
+}
+
+// Variables to split on in cube-and-conquer: borders between differently colored cells, which decide how units are
+// paired into blocks, nearest to clues first.
+std::vector<Glucose::Var> CubeSplitVariables(const Problem& problem, Glucose::Var origin) {
     int height = problem.height();
     int width = problem.width();
-    ret.horizontal = std::vector<std::vector<DoublechocoAnswer::Border>>(height);
-    ret.vertical = std::vector<std::vector<DoublechocoAnswer::Border>>(height - 1);
 
+    // distance from the nearest clue
+    Grid<int> dist(height, width, -1);
+    std::vector<std::pair<int, int>> queue;
     for (int y = 0; y < height; ++y) {
-        for (int x = 0; x < width - 1; ++x) {
-            ret.horizontal[y].push_back(ConvertBorder(board.horizontal(y, x)));
+        for (int x = 0; x < width; ++x) {
+            if (problem.num(y, x) > 0) {
+                dist.at(y, x) = 0;
+                queue.push_back({y, x});
+            }
         }
     }
-    for (int y = 0; y < height - 1; ++y) {
+    for (size_t i = 0; i < queue.size(); ++i) {
+        auto [y, x] = queue[i];
+        constexpr int dy[] = {-1, 0, 1, 0};
+        constexpr int dx[] = {0, -1, 0, 1};
+        for (int d = 0; d < 4; ++d) {
+            int y2 = y + dy[d], x2 = x + dx[d];
+            if (0 <= y2 && y2 < height && 0 <= x2 && x2 < width && dist.at(y2, x2) == -1) {
+                dist.at(y2, x2) = dist.at(y, x) + 1;
+                queue.push_back({y2, x2});
+            }
+        }
+    }
+    auto cell_dist = [&](int y, int x) { return dist.at(y, x) == -1 ? height + width : dist.at(y, x); };
+
+    std::vector<std::pair<int, Glucose::Var>> candidates;
+    for (int y = 0; y < height; ++y) {
         for (int x = 0; x < width; ++x) {
-            ret.vertical[y].push_back(ConvertBorder(board.vertical(y, x)));
+            if (x < width - 1 && problem.color(y, x) != problem.color(y, x + 1)) {
+                candidates.push_back({std::min(cell_dist(y, x), cell_dist(y, x + 1)), origin + y * (width - 1) + x});
+            }
+            if (y < height - 1 && problem.color(y, x) != problem.color(y + 1, x)) {
+                candidates.push_back({std::min(cell_dist(y, x), cell_dist(y + 1, x)),
+                                      origin + height * (width - 1) + y * width + x});
+            }
         }
     }
+    std::sort(candidates.begin(), candidates.end());
+
+    std::vector<Glucose::Var> ret;
+    for (auto [d, v] : candidates) {
+        ret.push_back(v);
+    }
+    return ret;
+}
+
+// Finds a model by racing `options.portfolio_size` differently configured solvers, or by cube-and-conquer. Returns
+// the solver which found the model (or any solver if there is no model), and whether a model is found (l_Undef if
+// `budget` is exceeded).
+std::pair<SolverInstance, Glucose::lbool> FindFirstModel(const Problem& problem, const SolverOptions& options,
+                                                         const BudgetTracker& budget, ProgressReporter* progress) {
+    bool cube_and_conquer = options.use_cube_and_conquer && options.num_threads >= 2;
+    int num_solvers = cube_and_conquer ? options.num_threads : std::max(options.portfolio_size, 1);
+
+    std::vector<SolverInstance> instances;
+    std::vector<Glucose::Solver*> solvers;
+    for (int i = 0; i < num_solvers; ++i) {
+        instances.push_back(CreateSolver(problem, options, budget, progress));
+        if (!cube_and_conquer) {
+            DiversifySolver(*instances.back().solver, i);
+        }
+        solvers.push_back(instances.back().solver.get());
+    }
+
+    Glucose::lbool result;
+    int winner;
+    if (cube_and_conquer) {
+        winner = SolveByCubes(solvers, CubeSplitVariables(problem, instances[0].origin),
+                              options.cube_and_conquer_options, result);
+        if (winner == -1) {
+            winner = 0;
+        }
+    } else {
+        winner = SolvePortfolio(solvers, result);
+    }
+    return {std::move(instances[winner]), result};
+}
+
+} // namespace
+
+std::optional<DoublechocoAnswer> FindAnswer(const Problem& problem, const SolverOptions& options) {
+    SolveResult res = FindAnswerLimited(problem, SolveBudget(), options);
+    assert(res.status != SolveResult::kUnknown);
+    return res.answer;
+}
+
+std::optional<DoublechocoAnswer> Solve(const Problem& problem, const SolverOptions& options) {
+    SolveResult res = SolveLimited(problem, SolveBudget(), options);
+    assert(res.status != SolveResult::kUnknown);
+    return res.answer;
+}
+
+SolveResult FindAnswerLimited(const Problem& problem, const SolveBudget& budget, const SolverOptions& options) {
+    BudgetTracker tracker(budget);
+    std::unique_ptr<ProgressReporter> progress = CreateProgressReporter(options);
+    auto [instance, result] = FindFirstModel(problem, options, tracker, progress.get());
+    CollectStats(options, instance, progress.get());
+
+    SolveResult ret;
+    if (result == l_True) {
+        ret.status = SolveResult::kSolved;
+        ret.answer = AnswerFromModel(problem, instance.origin, *instance.solver);
+    } else {
+        ret.status = result == l_False ? SolveResult::kNoAnswer : SolveResult::kUnknown;
+    }
+    return ret;
+}
+
+SolveResult SolveLimited(const Problem& problem, const SolveBudget& budget, const SolverOptions& options) {
+    BudgetTracker tracker(budget);
+    std::unique_ptr<ProgressReporter> progress = CreateProgressReporter(options);
+    SolveResult ret;
+    auto [instance, result] = FindFirstModel(problem, options, tracker, progress.get());
+    if (result != l_True) {
+        CollectStats(options, instance, progress.get());
+        ret.status = result == l_False ? SolveResult::kNoAnswer : SolveResult::kUnknown;
+        return ret;
+    }
+
+    Glucose::Solver& solver = *instance.solver;
+    Glucose::Var origin = instance.origin;
+
+    BoardManager board(problem, origin);
+    std::vector<Glucose::Var> related_vars = board.RelatedVariables();
+
+    auto build_solver = [&](Glucose::Solver& worker_solver) {
+        Glucose::Var worker_origin =
+            BoardManager::AllocateVariables(worker_solver, problem.height(), problem.width());
+        assert(worker_origin == origin);
+        AddConstraints(problem, options, tracker, progress.get(), worker_solver, worker_origin);
+    };
+    BackboneListener listener(problem, origin, options, progress.get());
+    bool complete;
+    for (Glucose::Lit lit :
+         ComputeBackboneParallel(solver, related_vars, build_solver, options.num_threads, &complete, &listener)) {
+        board.Decide(lit);
+    }
+
+    CollectStats(options, instance, progress.get());
+
+    ret.status = complete ? SolveResult::kSolved : SolveResult::kUnknown;
+    ret.answer = AnswerFromBoard(board);
     return ret;
 }
 
+UniquenessResult CheckUniqueness(const Problem& problem, const SolverOptions& options) {
+    UniquenessResult res = CheckUniquenessLimited(problem, SolveBudget(), options);
+    assert(res.status != UniquenessResult::kUnknown);
+    return res;
+}
+
+UniquenessResult CheckUniquenessLimited(const Problem& problem, const SolveBudget& budget,
+                                        const SolverOptions& options) {
+    UniquenessResult ret;
+    BudgetTracker tracker(budget);
+    std::unique_ptr<ProgressReporter> progress = CreateProgressReporter(options);
+    auto [instance, result] = FindFirstModel(problem, options, tracker, progress.get());
+    if (result != l_True) {
+        CollectStats(options, instance, progress.get());
+        ret.status = result == l_False ? UniquenessResult::kNoAnswer : UniquenessResult::kUnknown;
+        return ret;
+    }
+
+    Glucose::Solver& solver = *instance.solver;
+    ret.first = AnswerFromModel(problem, instance.origin, solver);
+
+    // Block the first answer, projected onto the border variables
+    BoardManager board(problem, instance.origin);
+    Glucose::vec<Glucose::Lit> blocking;
+    for (Glucose::Var v : board.RelatedVariables()) {
+        blocking.push(Glucose::mkLit(v, solver.modelValue(v) == l_True));
+    }
+    solver.addClause(blocking);
+
+    Glucose::vec<Glucose::Lit> assumptions;
+    Glucose::lbool second = solver.solveLimited(assumptions);
+    if (second == l_True) {
+        ret.status = UniquenessResult::kMultiple;
+        ret.second = AnswerFromModel(problem, instance.origin, solver);
+    } else {
+        ret.status = second == l_False ? UniquenessResult::kUnique : UniquenessResult::kUnknown;
+    }
+    CollectStats(options, instance, progress.get());
+    return ret;
+}
+
+SolveHandle<SolveResult> SolveAsync(const Problem& problem, const SolverOptions& options, const SolveBudget& budget,
+                                    const Executor& executor) {
+    return StartSolveAsync<SolveResult>(
+        [problem, options](const SolveBudget& task_budget) { return SolveLimited(problem, task_budget, options); },
+        budget, executor);
+}
+
 }
@@ -1,7 +1,14 @@
 #pragma once
 
 #include "doublechoco/Problem.h"
+#include "AsyncSolve.h"
+#include "Budget.h"
+#include "CubeAndConquer.h"
+#include "Progress.h"
+#include "SearchStats.h"
+#include "SimplePropagator.h"
 
+#include <functional>
 #include <optional>
 #include <vector>
 
@@ -17,7 +24,104 @@ struct DoublechocoAnswer {
     std::vector<std::vector<Border>> horizontal, vertical;
 };
 
-std::optional<DoublechocoAnswer> FindAnswer(const Problem& problem);
-std::optional<DoublechocoAnswer> Solve(const Problem& problem);
+// A border whose status is proven while computing the backbone
+struct BorderDeduction {
+    // Whether this is `DoublechocoAnswer::horizontal[y][x]` (between (y, x) and (y, x + 1)) or `vertical[y][x]`
+    // (between (y, x) and (y + 1, x))
+    bool is_horizontal;
+    int y, x;
+    // `kWall` or `kConnected` if the border is the same in all answers, or `kUndecided` if answers differ on it
+    DoublechocoAnswer::Border border;
+};
+
+struct SolverOptions {
+    // Add `Balancer`, which requires every potential block to have the equal number of black and white cells.
+    // Enabled by default; doublechoco-benchmark compares the solver with and without it.
+    bool use_balancer = true;
+
+    // When the shape finder (the expensive tier of `Propagator`) is run
+    ExpensiveTierSchedule shape_finder_schedule = ExpensiveTierSchedule::kAtFixpoint;
+
+    // If not null, the counters of `Propagator` are added to this after solving. In `Solve`, only the solver on the
+    // calling thread is counted.
+    SimplePropagatorStats* propagator_stats = nullptr;
+
+    // If not null, the search counters are added to this after solving, with the same restriction as
+    // `propagator_stats`
+    SearchStats* search_stats = nullptr;
+
+    // Number of threads used for computing the backbone in `Solve`
+    int num_threads = 1;
+
+    // Number of differently configured solvers raced on their own threads for the first answer. This is meant for
+    // reducing the time spent on occasional hard puzzles rather than the average.
+    int portfolio_size = 1;
+
+    // Find the first answer by cube-and-conquer with `num_threads` workers, which is meant for very large boards.
+    // This takes precedence over `portfolio_size`.
+    bool use_cube_and_conquer = false;
+    CubeAndConquerOptions cube_and_conquer_options;
+
+    // If set, called with the progress of the call about every `progress_interval_ms` milliseconds, and once at the
+    // end. `SolveProgress::num_fixed` counts borders.
+    ProgressCallback progress;
+    int64_t progress_interval_ms = 100;
+
+    // If set, `Solve` (as well as `SolveLimited` and `SolveAsync`) calls this as soon as each border is proven, so that
+    // deductions can be shown before the call completes. It is called on the threads of the backbone computation, but
+    // never concurrently. Borders not reported by the end of a `kUnknown` call are not proven either way.
+    std::function<void(const BorderDeduction&)> on_border;
+};
+
+struct SolveResult {
+    enum Status {
+        kSolved,
+        kNoAnswer,
+        // The budget is exceeded before the call completes
+        kUnknown,
+    };
+
+    Status status;
+    // With `kSolved`, the answer (as returned by `FindAnswer` or `Solve`). With `kUnknown` in `SolveLimited`, the
+    // borders proven to be common to all answers before the budget is exceeded, or nullopt if not even the first answer
+    // is found.
+    std::optional<DoublechocoAnswer> answer;
+};
+
+struct UniquenessResult {
+    enum Status {
+        kNoAnswer,
+        kUnique,
+        kMultiple,
+        // The budget is exceeded before the call completes
+        kUnknown,
+    };
+
+    Status status;
+    // An answer (unless `kNoAnswer`, or `kUnknown` before any answer is found) and another one (only if `kMultiple`),
+    // without undecided borders
+    std::optional<DoublechocoAnswer> first, second;
+};
+
+std::optional<DoublechocoAnswer> FindAnswer(const Problem& problem, const SolverOptions& options = SolverOptions());
+std::optional<DoublechocoAnswer> Solve(const Problem& problem, const SolverOptions& options = SolverOptions());
+
+// Same as `FindAnswer` and `Solve`, but stop with `SolveResult::kUnknown` when `budget` is exceeded
+SolveResult FindAnswerLimited(const Problem& problem, const SolveBudget& budget,
+                              const SolverOptions& options = SolverOptions());
+SolveResult SolveLimited(const Problem& problem, const SolveBudget& budget,
+                         const SolverOptions& options = SolverOptions());
+
+// Determines whether `problem` has no answer, exactly one, or more. This stops at the second answer, so it is much
+// cheaper than `Solve` when only uniqueness matters.
+UniquenessResult CheckUniqueness(const Problem& problem, const SolverOptions& options = SolverOptions());
+
+// Same as `CheckUniqueness`, but stop with `UniquenessResult::kUnknown` when `budget` is exceeded
+UniquenessResult CheckUniquenessLimited(const Problem& problem, const SolveBudget& budget,
+                                        const SolverOptions& options = SolverOptions());
+
+// Runs `SolveLimited` on `executor` (see `StartSolveAsync`). The objects pointed to by `options` must outlive the call.
+SolveHandle<SolveResult> SolveAsync(const Problem& problem, const SolverOptions& options = SolverOptions(),
+                                    const SolveBudget& budget = SolveBudget(), const Executor& executor = nullptr);
 
 }
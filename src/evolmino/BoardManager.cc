@@ -1,13 +1,20 @@
 #include "evolmino/BoardManager.h"
 
+#include <algorithm>
 #include <cassert>
-#include <queue>
+#include <tuple>
+
+#include "ConnectedComponents.h"
 
 namespace evolmino {
 
 BoardManager::BoardManager(const Problem& problem, Glucose::Var origin)
     : height_(problem.height()), width_(problem.width()), problem_(problem), origin_(origin),
-      cells_(problem.height() * problem.width(), Cell::kUndecided) {}
+      cells_(problem.height() * problem.width(), Cell::kUndecided),
+      component_id_(problem.height(), problem.width(), -1), path_parent_(problem.height(), problem.width(), {-1, -1}) {
+    component_stack_.reserve(height_ * width_);
+    path_queue_.reserve(height_ * width_);
+}
 
 BoardManager::Cell BoardManager::cell(int y, int x) const {
     assert(0 <= y && y < height_ && 0 <= x && x < width_);
@@ -68,51 +75,20 @@ Glucose::Var BoardManager::AllocateVariables(Glucose::Solver& solver, int height
 
 namespace {
 
-void ComputeConnectedComponentsSearch(const BoardManager& board, bool is_potential, Grid<int>& group_id, int y, int x, int id) {
-    if (group_id.at(y, x) != -1) {
-        return;
-    }
-    if (is_potential) {
-        if (board.cell(y, x) == BoardManager::Cell::kEmpty) return;
-    } else {
-        if (board.cell(y, x) != BoardManager::Cell::kSquare) return;
-    }
-
-    group_id.at(y, x) = id;
+// Square cells (or non-empty cells if `is_potential` is true) are connected to all adjacent ones.
+struct BlockPolicy {
+    const BoardManager& board;
+    bool is_potential;
 
-    if (y > 0) {
-        ComputeConnectedComponentsSearch(board, is_potential, group_id, y - 1, x, id);
-    }
-    if (y < board.height() - 1) {
-        ComputeConnectedComponentsSearch(board, is_potential, group_id, y + 1, x, id);
-    }
-    if (x > 0) {
-        ComputeConnectedComponentsSearch(board, is_potential, group_id, y, x - 1, id);
-    }
-    if (x < board.width() - 1) {
-        ComputeConnectedComponentsSearch(board, is_potential, group_id, y, x + 1, id);
-    }
-}
-
-Grid<int> ComputeConnectedComponents(const BoardManager& board, bool is_potential) {
-    Grid<int> group_id(board.height(), board.width(), -1);
-    int id_last = 0;
-
-    for (int y = 0; y < board.height(); ++y) {
-        for (int x = 0; x < board.width(); ++x) {
-            if (group_id.at(y, x) == -1 && (is_potential || board.cell(y, x) == BoardManager::Cell::kSquare)) {
-                if (is_potential) {
-                    if (board.cell(y, x) == BoardManager::Cell::kEmpty) continue;
-                } else {
-                    if (board.cell(y, x) != BoardManager::Cell::kSquare) continue;
-                }
-                ComputeConnectedComponentsSearch(board, is_potential, group_id, y, x, id_last++);
-            }
+    bool Contains(int y, int x) const {
+        if (is_potential) {
+            return board.cell(y, x) != BoardManager::Cell::kEmpty;
+        } else {
+            return board.cell(y, x) == BoardManager::Cell::kSquare;
         }
     }
-
-    return group_id;
-}
+    bool Passable(int y, int x, int y2, int x2) const { return true; }
+};
 
 }
 
@@ -123,18 +99,18 @@ const int kFourNeighborX[] = {0, -1, 0, 1};
 
 }
 
-std::vector<Glucose::Lit> BoardManager::ReasonForPath(int ya, int xa, int yb, int xb) const {
+void BoardManager::ReasonForPath(int ya, int xa, int yb, int xb, std::vector<Glucose::Lit>& out) const {
     assert(cell(ya, xa) == Cell::kSquare);
     assert(cell(yb, xb) == Cell::kSquare);
 
-    Grid<std::pair<int, int>> bfs(height_, width_, {-1, -1});
-    std::queue<std::pair<int, int>> qu;
+    Grid<std::pair<int, int>>& bfs = path_parent_;
+    bfs.fill({-1, -1});
+    path_queue_.clear();
     bfs.at(ya, xa) = std::make_pair(-2, -2);
-    qu.push({ya, xa});
+    path_queue_.push_back({ya, xa});
 
-    while (!qu.empty()) {
-        auto [y, x] = qu.front();
-        qu.pop();
+    for (size_t head = 0; head < path_queue_.size(); ++head) {
+        auto [y, x] = path_queue_[head];
 
         if (y == yb && x == xb) {
             break;
@@ -154,54 +130,49 @@ std::vector<Glucose::Lit> BoardManager::ReasonForPath(int ya, int xa, int yb, in
                 continue;
             }
             bfs.at(y2, x2) = std::make_pair(y, x);
-            qu.push({y2, x2});
+            path_queue_.push_back({y2, x2});
         }
     }
 
     assert(bfs.at(yb, xb).first != -1);
-    std::vector<Glucose::Lit> ret;
 
     int y = yb, x = xb;
     while (y >= 0 && x >= 0) {
-        ret.push_back(Glucose::mkLit(CellVar(y, x)));
+        out.push_back(Glucose::mkLit(CellVar(y, x)));
         std::tie(y, x) = bfs.at(y, x);
     }
-
-    return ret;
 }
 
-std::vector<Glucose::Lit> BoardManager::ReasonForPotentialUnitBoundary(const BoardInfoSimple& info, int potential_group_id) const {
-    std::vector<Glucose::Lit> ret;
+void BoardManager::ReasonForPotentialUnitBoundary(const BoardInfoSimple& info, int potential_group_id,
+                                                  std::vector<Glucose::Lit>& out) const {
+    size_t begin = out.size();
     for (auto [y, x] : info.potential_blocks.group(potential_group_id)) {
         for (int d = 0; d < 4; ++d) {
             int y2 = y + kFourNeighborY[d];
             int x2 = x + kFourNeighborX[d];
             if (!(0 <= y2 && y2 < height_ && 0 <= x2 && x2 < width_)) continue;
             if (cell(y2, x2) == Cell::kEmpty) {
-                ret.push_back(Glucose::mkLit(CellVar(y2, x2), true));
+                out.push_back(Glucose::mkLit(CellVar(y2, x2), true));
             }
         }
     }
-    std::sort(ret.begin(), ret.end());
-    ret.erase(std::unique(ret.begin(), ret.end()), ret.end());
-    return ret;
+    std::sort(out.begin() + begin, out.end());
+    out.erase(std::unique(out.begin() + begin, out.end()), out.end());
 }
 
-std::vector<Glucose::Lit> BoardManager::ReasonForBlock(const BoardInfoDetailed& info, int block_id) const {
-    std::vector<Glucose::Lit> ret;
-
+void BoardManager::ReasonForBlock(const BoardInfoDetailed& info, int block_id, std::vector<Glucose::Lit>& out) const {
     for (auto [y, x] : info.blocks[block_id]) {
-        ret.push_back(Glucose::mkLit(CellVar(y, x)));
+        out.push_back(Glucose::mkLit(CellVar(y, x)));
     }
-
-    return ret;
 }
 
-std::vector<Glucose::Lit> BoardManager::ReasonForAdjacentFloatingBoundary(const BoardInfoDetailed& info, int block_id) const {
-    std::vector<Glucose::Lit> ret;
+void BoardManager::ReasonForAdjacentFloatingBoundary(const BoardInfoDetailed& info, int block_id,
+                                                     std::vector<Glucose::Lit>& out) const {
+    size_t begin = out.size();
 
     // empty cell adjacent to a block cell
-    std::vector<int> disturbing_blocks;
+    std::vector<int>& disturbing_blocks = reason_blocks_;
+    disturbing_blocks.clear();
     for (auto [y, x] : info.blocks[block_id]) {
         for (int d = 0; d < 4; ++d) {
             int y2 = y + kFourNeighborY[d];
@@ -209,7 +180,7 @@ std::vector<Glucose::Lit> BoardManager::ReasonForAdjacentFloatingBoundary(const
 
             if (!(0 <= y2 && y2 < height_ && 0 <= x2 && x2 < width_)) continue;
             if (cell(y2, x2) == Cell::kEmpty) {
-                ret.push_back(Glucose::mkLit(CellVar(y2, x2), true));
+                out.push_back(Glucose::mkLit(CellVar(y2, x2), true));
             } else if (cell(y2, x2) == Cell::kUndecided) {
                 for (int e = 0; e < 4; ++e) {
                     int y3 = y2 + kFourNeighborY[e];
@@ -233,13 +204,14 @@ std::vector<Glucose::Lit> BoardManager::ReasonForAdjacentFloatingBoundary(const
 
             if (!(0 <= y2 && y2 < height_ && 0 <= x2 && x2 < width_)) continue;
             if (cell(y2, x2) == Cell::kEmpty) {
-                ret.push_back(Glucose::mkLit(CellVar(y2, x2), true));
+                out.push_back(Glucose::mkLit(CellVar(y2, x2), true));
             }
         }
     }
 
     // enumerate floating regions adjacent to a block-neighbor cell
-    std::vector<int> adjacent_floatings;
+    std::vector<int>& adjacent_floatings = reason_floatings_;
+    adjacent_floatings.clear();
     for (auto [y, x] : info.block_neighbors[block_id]) {
         for (int d = 0; d < 4; ++d) {
             int y2 = y + kFourNeighborY[d];
@@ -265,7 +237,7 @@ std::vector<Glucose::Lit> BoardManager::ReasonForAdjacentFloatingBoundary(const
 
                 if (!(0 <= y2 && y2 < height_ && 0 <= x2 && x2 < width_)) continue;
                 if (cell(y2, x2) == Cell::kEmpty) {
-                    ret.push_back(Glucose::mkLit(CellVar(y2, x2), true));
+                    out.push_back(Glucose::mkLit(CellVar(y2, x2), true));
                     continue;
                 }
 
@@ -283,43 +255,41 @@ std::vector<Glucose::Lit> BoardManager::ReasonForAdjacentFloatingBoundary(const
 
     for (int d : disturbing_blocks) {
         for (auto [y, x] : info.blocks[d]) {
-            ret.push_back(Glucose::mkLit(CellVar(y, x)));
+            out.push_back(Glucose::mkLit(CellVar(y, x)));
         }
     }
 
-    std::sort(ret.begin(), ret.end());
-    ret.erase(std::unique(ret.begin(), ret.end()), ret.end());
-
-    return ret;
+    std::sort(out.begin() + begin, out.end());
+    out.erase(std::unique(out.begin() + begin, out.end()), out.end());
 }
 
 BoardInfoSimple BoardManager::ComputeBoardInfoSimple() const {
-    return BoardInfoSimple {
-        ComputeConnectedComponents(*this, false),
-        ComputeConnectedComponents(*this, true),
+    BoardInfoSimple info{
+        GroupInfo(height_, width_),
+        GroupInfo(height_, width_),
     };
+    ComputeBoardInfoSimple(info);
+    return info;
 }
 
-namespace {
+void BoardManager::ComputeBoardInfoSimple(BoardInfoSimple& info) const {
+    auto component_id_of = [&](int y, int x) { return component_id_.at(y, x); };
 
-void TraverseFloatingComponents(Grid<std::pair<BoardInfoDetailed::CellKind, int>>& cell_info, int y, int x, int id) {
-    if (cell_info.at(y, x).second != -2) return;
+    LabelConnectedComponents(BlockPolicy{*this, false}, component_id_, component_stack_);
+    info.blocks.Assign(component_id_of);
+    LabelConnectedComponents(BlockPolicy{*this, true}, component_id_, component_stack_);
+    info.potential_blocks.Assign(component_id_of);
+}
 
-    cell_info.at(y, x) = std::make_pair(BoardInfoDetailed::CellKind::kFloating, id);
+namespace {
 
-    if (y > 0) {
-        TraverseFloatingComponents(cell_info, y - 1, x, id);
-    }
-    if (y < cell_info.height() - 1) {
-        TraverseFloatingComponents(cell_info, y + 1, x, id);
-    }
-    if (x > 0) {
-        TraverseFloatingComponents(cell_info, y, x - 1, id);
-    }
-    if (x < cell_info.width() - 1) {
-        TraverseFloatingComponents(cell_info, y, x + 1, id);
-    }
-}
+// Cells which are not classified yet form floating components.
+struct FloatingPolicy {
+    const Grid<std::pair<BoardInfoDetailed::CellKind, int>>& cell_info;
+
+    bool Contains(int y, int x) const { return cell_info.at(y, x).second == -2; }
+    bool Passable(int y, int x, int y2, int x2) const { return true; }
+};
 
 }
 
@@ -386,11 +356,12 @@ BoardInfoDetailed BoardManager::ComputeBoardInfoDetailed(const BoardInfoSimple&
         }
     }
 
-    int num_floatings = 0;
+    int num_floatings = LabelConnectedComponents(FloatingPolicy{cell_info}, component_id_, component_stack_);
     for (int y = 0; y < height_; ++y) {
         for (int x = 0; x < width_; ++x) {
-            if (cell_info.at(y, x).second != -2) continue;
-            TraverseFloatingComponents(cell_info, y, x, num_floatings++);
+            if (component_id_.at(y, x) >= 0) {
+                cell_info.at(y, x) = std::make_pair(BoardInfoDetailed::CellKind::kFloating, component_id_.at(y, x));
+            }
         }
     }
 
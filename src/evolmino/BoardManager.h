@@ -70,20 +70,28 @@ public:
 
     static Glucose::Var AllocateVariables(Glucose::Solver& solver, int height, int width);
 
+    // The following functions append a reason to `out`, reusing the work areas of this object so that no allocation
+    // happens in steady state.
+
     // Compute the reason why cells (ya, xa) and (yb, xb) are connected via square cells
-    std::vector<Glucose::Lit> ReasonForPath(int ya, int xa, int yb, int xb) const;
+    void ReasonForPath(int ya, int xa, int yb, int xb, std::vector<Glucose::Lit>& out) const;
 
     // Compute the reason prohibiting a potential block from expanding
-    std::vector<Glucose::Lit> ReasonForPotentialUnitBoundary(const BoardInfoSimple& info, int potential_group_id) const;
+    void ReasonForPotentialUnitBoundary(const BoardInfoSimple& info, int potential_group_id,
+                                        std::vector<Glucose::Lit>& out) const;
 
     // Compute the reason why a block is of at least the current size
-    std::vector<Glucose::Lit> ReasonForBlock(const BoardInfoDetailed& info, int block_id) const;
+    void ReasonForBlock(const BoardInfoDetailed& info, int block_id, std::vector<Glucose::Lit>& out) const;
 
     // Compute the reason prohibiting a block from expanding beyond adjacent floating regions
-    std::vector<Glucose::Lit> ReasonForAdjacentFloatingBoundary(const BoardInfoDetailed& info, int block_id) const;
+    void ReasonForAdjacentFloatingBoundary(const BoardInfoDetailed& info, int block_id,
+                                           std::vector<Glucose::Lit>& out) const;
 
     BoardInfoSimple ComputeBoardInfoSimple() const;
 
+    // Same as `ComputeBoardInfoSimple()`, but reuses `info`, which must be for a board of the same size
+    void ComputeBoardInfoSimple(BoardInfoSimple& info) const;
+
     // This function must NOT be called if there exists a block containing more than one arrow cells.
     BoardInfoDetailed ComputeBoardInfoDetailed(const BoardInfoSimple& info) const;
 
@@ -95,6 +103,15 @@ private:
     Glucose::Var origin_;
     std::vector<Cell> cells_;
     std::vector<Glucose::Lit> decisions_;
+
+    // Work area for the connected component labeling in `ComputeBoardInfoSimple` and `ComputeBoardInfoDetailed`
+    mutable Grid<int> component_id_;
+    mutable std::vector<std::pair<int, int>> component_stack_;
+
+    // Work area for the reason computation
+    mutable Grid<std::pair<int, int>> path_parent_;
+    mutable std::vector<std::pair<int, int>> path_queue_;
+    mutable std::vector<int> reason_blocks_, reason_floatings_;
 };
 
 }
@@ -2,7 +2,12 @@
 
 namespace evolmino {
 
-Propagator::Propagator(const Problem& problem, Glucose::Var origin) : problem_(problem), board_(problem, origin) {}
+Propagator::Propagator(const Problem& problem, Glucose::Var origin)
+    : problem_(problem), board_(problem, origin),
+      board_info_simple_{
+          GroupInfo(problem.height(), problem.width()),
+          GroupInfo(problem.height(), problem.width()),
+      } {}
 
 std::vector<Glucose::Var> Propagator::RelatedVariables() {
     return board_.RelatedVariables();
@@ -23,8 +28,9 @@ const int kFourNeighborX[] = {0, -1, 0, 1};
 
 }
 
-std::optional<std::vector<Glucose::Lit>> Propagator::DetectInconsistency() {
-    BoardInfoSimple board_info_simple = board_.ComputeBoardInfoSimple();
+const std::vector<Glucose::Lit>* Propagator::DetectInconsistency() {
+    board_.ComputeBoardInfoSimple(board_info_simple_);
+    const BoardInfoSimple& board_info_simple = board_info_simple_;
 
     // Each block is reachable to an arrow cell
     for (int i = 0; i < board_info_simple.potential_blocks.num_groups(); ++i) {
@@ -39,9 +45,10 @@ std::optional<std::vector<Glucose::Lit>> Propagator::DetectInconsistency() {
             }
         }
         if (square_cell.first != -1 && !has_arrow) {
-            std::vector<Glucose::Lit> ret = board_.ReasonForPotentialUnitBoundary(board_info_simple, i);
-            ret.push_back(Glucose::mkLit(board_.CellVar(square_cell.first, square_cell.second)));
-            return ret;
+            reason_.clear();
+            board_.ReasonForPotentialUnitBoundary(board_info_simple, i, reason_);
+            reason_.push_back(Glucose::mkLit(board_.CellVar(square_cell.first, square_cell.second)));
+            return &reason_;
         }
     }
 
@@ -53,7 +60,9 @@ std::optional<std::vector<Glucose::Lit>> Propagator::DetectInconsistency() {
                 if (arrow_cell.first == -1) {
                     arrow_cell = std::make_pair(y, x);
                 } else {
-                    return board_.ReasonForPath(y, x, arrow_cell.first, arrow_cell.second);
+                    reason_.clear();
+                    board_.ReasonForPath(y, x, arrow_cell.first, arrow_cell.second, reason_);
+                    return &reason_;
                 }
             }
         }
@@ -126,12 +135,11 @@ std::optional<std::vector<Glucose::Lit>> Propagator::DetectInconsistency() {
                     }
 
                     if (!isok) {
-                        std::vector<Glucose::Lit> ret = board_.ReasonForBlock(board_info_detail, last_block_id);
-                        ret.push_back(Glucose::mkLit(board_.CellVar(arrow[j].first, arrow[j].second)));
-                        for (auto lit : board_.ReasonForAdjacentFloatingBoundary(board_info_detail, block_id)) {
-                            ret.push_back(lit);
-                        }
-                        return ret;
+                        reason_.clear();
+                        board_.ReasonForBlock(board_info_detail, last_block_id, reason_);
+                        reason_.push_back(Glucose::mkLit(board_.CellVar(arrow[j].first, arrow[j].second)));
+                        board_.ReasonForAdjacentFloatingBoundary(board_info_detail, block_id, reason_);
+                        return &reason_;
                     }
                 }
 
@@ -199,26 +207,24 @@ std::optional<std::vector<Glucose::Lit>> Propagator::DetectInconsistency() {
 
                 if (cur_ub < last_lb + 1) {
                     // the last block is too large and the current block cannot be large enough
-                    std::vector<Glucose::Lit> ret = board_.ReasonForBlock(board_info_detail, last_block_id);
-                    ret.push_back(Glucose::mkLit(board_.CellVar(arrow[j].first, arrow[j].second)));
-                    for (auto lit : board_.ReasonForAdjacentFloatingBoundary(board_info_detail, cur_block_id)) {
-                        ret.push_back(lit);
-                    }
-                    return ret;
+                    reason_.clear();
+                    board_.ReasonForBlock(board_info_detail, last_block_id, reason_);
+                    reason_.push_back(Glucose::mkLit(board_.CellVar(arrow[j].first, arrow[j].second)));
+                    board_.ReasonForAdjacentFloatingBoundary(board_info_detail, cur_block_id, reason_);
+                    return &reason_;
                 }
                 if (last_ub + gap_ub < cur_lb) {
                     // the current block is too large and the last block cannot be large enough
-                    std::vector<Glucose::Lit> ret = board_.ReasonForBlock(board_info_detail, cur_block_id);
-                    ret.push_back(Glucose::mkLit(board_.CellVar(arrow[last_block_idx].first, arrow[last_block_idx].second)));
-                    for (auto lit : board_.ReasonForAdjacentFloatingBoundary(board_info_detail, last_block_id)) {
-                        ret.push_back(lit);
-                    }
+                    reason_.clear();
+                    board_.ReasonForBlock(board_info_detail, cur_block_id, reason_);
+                    reason_.push_back(Glucose::mkLit(board_.CellVar(arrow[last_block_idx].first, arrow[last_block_idx].second)));
+                    board_.ReasonForAdjacentFloatingBoundary(board_info_detail, last_block_id, reason_);
                     for (int k = last_block_idx + 2; k < j - 1; ++k) {
                         if (board_.cell(arrow[k]) == BoardManager::Cell::kEmpty) {
-                            ret.push_back(Glucose::mkLit(board_.CellVar(arrow[k].first, arrow[k].second), true));
+                            reason_.push_back(Glucose::mkLit(board_.CellVar(arrow[k].first, arrow[k].second), true));
                         }
                     }
-                    return ret;
+                    return &reason_;
                 }
             }
 
@@ -227,7 +233,7 @@ std::optional<std::vector<Glucose::Lit>> Propagator::DetectInconsistency() {
     }
 
     // No inconsistency
-    return std::nullopt;
+    return nullptr;
 }
 
 }
@@ -1,6 +1,6 @@
 #pragma once
 
-#include <optional>
+#include <vector>
 
 #include "core/Constraint.h"
 #include "core/Solver.h"
@@ -19,12 +19,16 @@ public:
     std::vector<Glucose::Var> RelatedVariables();
     void SimplePropagatorDecide(Glucose::Lit p);
     void SimplePropagatorUndo(Glucose::Lit p);
-    std::optional<std::vector<Glucose::Lit>> DetectInconsistency();
+    const std::vector<Glucose::Lit>* DetectInconsistency();
 
 private:
     Problem problem_;
     BoardManager board_;
     std::vector<std::vector<Glucose::Lit>> reasons_;
+
+    // Work area for `DetectInconsistency`
+    BoardInfoSimple board_info_simple_;
+    std::vector<Glucose::Lit> reason_;
 };
 
 }
@@ -0,0 +1,147 @@
+#include "evolmino/SolveCache.h"
+
+#include <algorithm>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace evolmino {
+
+namespace {
+
+// A cached result is "-" for no answer, and otherwise the cells in the canonical orientation: '#' for squares, 'x' for
+// empty cells and '.' for undecided ones.
+std::string EncodeResult(const Problem& problem, const GridTransform& transform, const SolveResult& result) {
+    if (result.status == SolveResult::kNoAnswer) {
+        return "-";
+    }
+    int canonical_width = transform.transformed_width();
+    std::string ret(problem.height() * problem.width(), '.');
+    for (int y = 0; y < problem.height(); ++y) {
+        for (int x = 0; x < problem.width(); ++x) {
+            auto [y2, x2] = transform.Apply(y, x);
+            char c = '.';
+            switch (result.answer->at(y, x)) {
+                case EvolminoAnswerCell::kSquare:
+                    c = '#';
+                    break;
+                case EvolminoAnswerCell::kEmpty:
+                    c = 'x';
+                    break;
+                default:
+                    break;
+            }
+            ret[y2 * canonical_width + x2] = c;
+        }
+    }
+    return ret;
+}
+
+// Returns std::nullopt if `value` is not a valid result for `problem` (e.g. a corrupted store), which is treated as a
+// cache miss.
+std::optional<SolveResult> DecodeResult(const Problem& problem, const GridTransform& transform,
+                                        const std::string& value) {
+    SolveResult ret;
+    if (value == "-") {
+        ret.status = SolveResult::kNoAnswer;
+        return ret;
+    }
+    if ((int)value.size() != problem.height() * problem.width()) {
+        return std::nullopt;
+    }
+    int canonical_width = transform.transformed_width();
+    EvolminoAnswer answer(problem.height(), problem.width(), EvolminoAnswerCell::kUndecided);
+    for (int y = 0; y < problem.height(); ++y) {
+        for (int x = 0; x < problem.width(); ++x) {
+            auto [y2, x2] = transform.Apply(y, x);
+            switch (value[y2 * canonical_width + x2]) {
+                case '#':
+                    answer.at(y, x) = EvolminoAnswerCell::kSquare;
+                    break;
+                case 'x':
+                    answer.at(y, x) = EvolminoAnswerCell::kEmpty;
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+    ret.status = SolveResult::kSolved;
+    ret.answer = answer;
+    return ret;
+}
+
+} // namespace
+
+CanonicalForm Canonicalize(const Problem& problem) {
+    int height = problem.height();
+    int width = problem.width();
+
+    std::optional<CanonicalForm> ret;
+    for (int t = 0; t < GridTransform::kNumTransforms; ++t) {
+        GridTransform transform(height, width, t);
+        int canonical_height = transform.transformed_height();
+        int canonical_width = transform.transformed_width();
+
+        std::string cells(height * width, '.');
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                auto [y2, x2] = transform.Apply(y, x);
+                char c = '.';
+                switch (problem.cell(y, x)) {
+                    case Problem::Cell::kEmpty:
+                        break;
+                    case Problem::Cell::kBlack:
+                        c = 'B';
+                        break;
+                    case Problem::Cell::kSquare:
+                        c = 'S';
+                        break;
+                }
+                cells[y2 * canonical_width + x2] = c;
+            }
+        }
+
+        // Arrows keep their directions, but their order in `problem` does not matter
+        std::vector<std::string> arrows;
+        for (int i = 0; i < problem.NumArrows(); ++i) {
+            std::string arrow;
+            for (auto [y, x] : problem.GetArrow(i)) {
+                auto [y2, x2] = transform.Apply(y, x);
+                arrow += std::to_string(y2 * canonical_width + x2) + ",";
+            }
+            arrows.push_back(arrow);
+        }
+        std::sort(arrows.begin(), arrows.end());
+
+        std::string key =
+            "evolmino/" + std::to_string(canonical_height) + "/" + std::to_string(canonical_width) + "/" + cells;
+        for (auto& arrow : arrows) {
+            key += "/" + arrow;
+        }
+        if (!ret || key < ret->key) {
+            ret = CanonicalForm{std::move(key), transform};
+        }
+    }
+    return *ret;
+}
+
+SolveResult SolveCached(const Problem& problem, ResultCache& cache, const SolveBudget& budget,
+                        const SolverOptions& options) {
+    CanonicalForm canonical = Canonicalize(problem);
+    std::optional<std::string> cached = cache.Get(canonical.key);
+    if (cached) {
+        std::optional<SolveResult> decoded = DecodeResult(problem, canonical.transform, *cached);
+        if (decoded) {
+            return *decoded;
+        }
+    }
+
+    SolveResult ret = SolveLimited(problem, budget, options);
+    if (ret.status != SolveResult::kUnknown) {
+        cache.Put(canonical.key, EncodeResult(problem, canonical.transform, ret));
+    }
+    return ret;
+}
+
+}
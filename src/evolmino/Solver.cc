@@ -1,9 +1,12 @@
 #include "evolmino/Solver.h"
 
-#include <map>
+#include <cassert>
+#include <memory>
 
 #include "core/Solver.h"
 
+#include "Backbone.h"
+
 #include "evolmino/BoardManager.h"
 #include "evolmino/Propagator.h"
 
@@ -11,11 +14,21 @@ namespace evolmino {
 
 namespace {
 
-void AddConstraints(const Problem& problem, Glucose::Solver& solver, Glucose::Var origin) {
+// The propagator interrupts `solver` when `budget` (if not null) is exceeded, and reports the search counters to
+// `progress` (if not null).
+void AddConstraints(const Problem& problem, Glucose::Solver& solver, Glucose::Var origin,
+                    const BudgetTracker* budget = nullptr, ProgressReporter* progress = nullptr) {
     int height = problem.height();
     int width = problem.width();
 
-    solver.addConstraint(std::make_unique<Propagator>(problem, origin));
+    auto propagator = std::make_unique<Propagator>(problem, origin);
+    if (budget != nullptr && budget->IsLimited()) {
+        propagator->SetBudget(budget);
+    }
+    if (progress != nullptr) {
+        propagator->SetProgress(progress);
+    }
+    solver.addConstraint(std::move(propagator));
 
     // initially placed black cells / squares
     for (int y = 0; y < height; ++y) {
@@ -62,17 +75,8 @@ void AddConstraints(const Problem& problem, Glucose::Solver& solver, Glucose::Va
     }
 }
 
-}
-
-std::optional<EvolminoAnswer> FindAnswer(const Problem& problem) {
-    Glucose::Solver solver;
-    Glucose::Var origin = BoardManager::AllocateVariables(solver, problem.height(), problem.width());
-
-    AddConstraints(problem, solver, origin);
-
-    if (!solver.solve())
-        return std::nullopt;
-
+// Converts the current model of `solver` into an answer without undecided cells
+EvolminoAnswer AnswerFromModel(const Problem& problem, Glucose::Var origin, const Glucose::Solver& solver) {
     int height = problem.height();
     int width = problem.width();
     EvolminoAnswer ret(height, width, EvolminoAnswerCell::kUndecided);
@@ -90,67 +94,196 @@ std::optional<EvolminoAnswer> FindAnswer(const Problem& problem) {
     return ret;
 }
 
-std::optional<EvolminoAnswer> Solve(const Problem& problem) {
+// Returns the reporter for `options.progress`, or null if it is not set
+std::unique_ptr<ProgressReporter> CreateProgressReporter(const SolverOptions& options) {
+    if (!options.progress) {
+        return nullptr;
+    }
+    return std::make_unique<ProgressReporter>(options.progress, options.progress_interval_ms);
+}
+
+// Passes the progress of the backbone computation to `progress` (if not null), and each proven cell to
+// `options.on_cell` (if set)
+class BackboneListener : public BackboneObserver {
+public:
+    BackboneListener(const Problem& problem, Glucose::Var origin, const SolverOptions& options,
+                     ProgressReporter* progress)
+        : width_(problem.width()), origin_(origin), on_cell_(options.on_cell), progress_(progress) {}
+
+    void OnProgress(int num_candidates, int num_proven) override {
+        if (progress_ != nullptr) {
+            progress_->OnProgress(num_candidates, num_proven);
+        }
+    }
+
+    // Positive literals are squares (see `BoardManager::Decide`)
+    void OnProven(Glucose::Lit lit) override {
+        Report(Glucose::var(lit), Glucose::sign(lit) ? EvolminoAnswerCell::kEmpty : EvolminoAnswerCell::kSquare);
+    }
+    void OnRefuted(Glucose::Lit lit) override { Report(Glucose::var(lit), EvolminoAnswerCell::kUndecided); }
+
+private:
+    void Report(Glucose::Var v, EvolminoAnswerCell cell) {
+        if (!on_cell_) {
+            return;
+        }
+        int ofs = v - origin_;
+        on_cell_(CellDeduction{ofs / width_, ofs % width_, cell});
+    }
+
+    int width_;
+    Glucose::Var origin_;
+    const std::function<void(const CellDeduction&)>& on_cell_;
+    ProgressReporter* progress_;
+};
+
+// Called at the end of a call
+void CollectStats(const SolverOptions& options, const Glucose::Solver& solver, ProgressReporter* progress) {
+    if (options.search_stats != nullptr) {
+        options.search_stats->Add(solver);
+    }
+    if (progress != nullptr) {
+        progress->Flush();
+    }
+}
+
+}
+
+std::optional<EvolminoAnswer> FindAnswer(const Problem& problem, const SolverOptions& options) {
+    SolveResult res = FindAnswerLimited(problem, SolveBudget(), options);
+    assert(res.status != SolveResult::kUnknown);
+    return res.answer;
+}
+
+std::optional<EvolminoAnswer> Solve(const Problem& problem, const SolverOptions& options) {
+    SolveResult res = SolveLimited(problem, SolveBudget(), options);
+    assert(res.status != SolveResult::kUnknown);
+    return res.answer;
+}
+
+SolveResult FindAnswerLimited(const Problem& problem, const SolveBudget& budget, const SolverOptions& options) {
+    BudgetTracker tracker(budget);
+    std::unique_ptr<ProgressReporter> progress = CreateProgressReporter(options);
     Glucose::Solver solver;
     Glucose::Var origin = BoardManager::AllocateVariables(solver, problem.height(), problem.width());
 
-    AddConstraints(problem, solver, origin);
+    AddConstraints(problem, solver, origin, &tracker, progress.get());
 
-    if (!solver.solve())
-        return std::nullopt;
+    Glucose::vec<Glucose::Lit> assumptions;
+    Glucose::lbool result = solver.solveLimited(assumptions);
+    CollectStats(options, solver, progress.get());
 
-    BoardManager board(problem, origin);
-    std::vector<Glucose::Var> related_vars = board.RelatedVariables();
-
-    std::map<Glucose::Var, bool> assignment;
-    for (auto v : related_vars) {
-        assignment.emplace(v, solver.modelValue(v) == l_True);
+    SolveResult ret;
+    if (result == l_True) {
+        ret.status = SolveResult::kSolved;
+        ret.answer = AnswerFromModel(problem, origin, solver);
+    } else {
+        ret.status = result == l_False ? SolveResult::kNoAnswer : SolveResult::kUnknown;
     }
+    return ret;
+}
 
-    for (;;) {
-        Glucose::vec<Glucose::Lit> refutation;
-        for (auto [var, val] : assignment) {
-            refutation.push(Glucose::mkLit(var, val));
-        }
-        solver.addClause(refutation);
+SolveResult SolveLimited(const Problem& problem, const SolveBudget& budget, const SolverOptions& options) {
+    BudgetTracker tracker(budget);
+    std::unique_ptr<ProgressReporter> progress = CreateProgressReporter(options);
+    Glucose::Solver solver;
+    Glucose::Var origin = BoardManager::AllocateVariables(solver, problem.height(), problem.width());
 
-        if (!solver.solve()) {
-            break;
-        }
-        for (auto it = assignment.begin(); it != assignment.end();) {
-            if ((solver.modelValue(it->first) == l_True) != it->second) {
-                it = assignment.erase(it);
-            } else {
-                ++it;
-            }
-        }
+    AddConstraints(problem, solver, origin, &tracker, progress.get());
+
+    SolveResult ret;
+    Glucose::vec<Glucose::Lit> assumptions;
+    Glucose::lbool result = solver.solveLimited(assumptions);
+    if (result != l_True) {
+        CollectStats(options, solver, progress.get());
+        ret.status = result == l_False ? SolveResult::kNoAnswer : SolveResult::kUnknown;
+        return ret;
     }
 
-    for (auto [var, val] : assignment) {
-        board.Decide(Glucose::mkLit(var, !val));
+    BoardManager board(problem, origin);
+    std::vector<Glucose::Var> related_vars = board.RelatedVariables();
+
+    BackboneListener listener(problem, origin, options, progress.get());
+    bool complete;
+    for (Glucose::Lit lit : ComputeBackbone(solver, related_vars, &complete, &listener)) {
+        board.Decide(lit);
     }
+    CollectStats(options, solver, progress.get());
 
     int height = problem.height();
     int width = problem.width();
-    EvolminoAnswer ret(height, width, EvolminoAnswerCell::kUndecided);
+    EvolminoAnswer answer(height, width, EvolminoAnswerCell::kUndecided);
 
     for (int y = 0; y < height; ++y) {
         for (int x = 0; x < width; ++x) {
             switch (board.cell(y, x)) {
                 case BoardManager::Cell::kUndecided:
-                    ret.at(y, x) = EvolminoAnswerCell::kUndecided;
+                    answer.at(y, x) = EvolminoAnswerCell::kUndecided;
                     break;
                 case BoardManager::Cell::kEmpty:
-                    ret.at(y, x) = EvolminoAnswerCell::kEmpty;
+                    answer.at(y, x) = EvolminoAnswerCell::kEmpty;
                     break;
                 case BoardManager::Cell::kSquare:
-                    ret.at(y, x) = EvolminoAnswerCell::kSquare;
+                    answer.at(y, x) = EvolminoAnswerCell::kSquare;
                     break;
             }
         }
     }
 
+    ret.status = complete ? SolveResult::kSolved : SolveResult::kUnknown;
+    ret.answer = answer;
     return ret;
 }
 
+UniquenessResult CheckUniqueness(const Problem& problem, const SolverOptions& options) {
+    UniquenessResult res = CheckUniquenessLimited(problem, SolveBudget(), options);
+    assert(res.status != UniquenessResult::kUnknown);
+    return res;
+}
+
+UniquenessResult CheckUniquenessLimited(const Problem& problem, const SolveBudget& budget,
+                                        const SolverOptions& options) {
+    BudgetTracker tracker(budget);
+    std::unique_ptr<ProgressReporter> progress = CreateProgressReporter(options);
+    Glucose::Solver solver;
+    Glucose::Var origin = BoardManager::AllocateVariables(solver, problem.height(), problem.width());
+
+    AddConstraints(problem, solver, origin, &tracker, progress.get());
+
+    UniquenessResult ret;
+    Glucose::vec<Glucose::Lit> assumptions;
+    Glucose::lbool result = solver.solveLimited(assumptions);
+    if (result != l_True) {
+        CollectStats(options, solver, progress.get());
+        ret.status = result == l_False ? UniquenessResult::kNoAnswer : UniquenessResult::kUnknown;
+        return ret;
+    }
+    ret.first = AnswerFromModel(problem, origin, solver);
+
+    // Block the first answer, projected onto the cell variables
+    BoardManager board(problem, origin);
+    Glucose::vec<Glucose::Lit> blocking;
+    for (Glucose::Var v : board.RelatedVariables()) {
+        blocking.push(Glucose::mkLit(v, solver.modelValue(v) == l_True));
+    }
+    solver.addClause(blocking);
+
+    Glucose::lbool second = solver.solveLimited(assumptions);
+    if (second == l_True) {
+        ret.status = UniquenessResult::kMultiple;
+        ret.second = AnswerFromModel(problem, origin, solver);
+    } else {
+        ret.status = second == l_False ? UniquenessResult::kUnique : UniquenessResult::kUnknown;
+    }
+    CollectStats(options, solver, progress.get());
+    return ret;
+}
+
+SolveHandle<SolveResult> SolveAsync(const Problem& problem, const SolverOptions& options, const SolveBudget& budget,
+                                    const Executor& executor) {
+    return StartSolveAsync<SolveResult>(
+        [problem, options](const SolveBudget& task_budget) { return SolveLimited(problem, task_budget, options); },
+        budget, executor);
+}
+
 }
@@ -1,9 +1,14 @@
 #pragma once
 
+#include <functional>
 #include <optional>
 #include <vector>
 
+#include "AsyncSolve.h"
+#include "Budget.h"
 #include "Grid.h"
+#include "Progress.h"
+#include "SearchStats.h"
 #include "evolmino/Problem.h"
 
 namespace evolmino {
@@ -16,7 +21,77 @@ enum EvolminoAnswerCell {
 
 using EvolminoAnswer = Grid<EvolminoAnswerCell>;
 
-std::optional<EvolminoAnswer> FindAnswer(const Problem& problem);
-std::optional<EvolminoAnswer> Solve(const Problem& problem);
+// A cell whose status is proven while computing the backbone
+struct CellDeduction {
+    int y, x;
+    // `kSquare` or `kEmpty` if the cell is the same in all answers, or `kUndecided` if answers differ on it
+    EvolminoAnswerCell cell;
+};
+
+struct SolverOptions {
+    // If not null, the search counters of the solver are added to this after solving
+    SearchStats* search_stats = nullptr;
+
+    // If set, called with the progress of the call about every `progress_interval_ms` milliseconds, and once at the
+    // end. `SolveProgress::num_fixed` counts cells.
+    ProgressCallback progress;
+    int64_t progress_interval_ms = 100;
+
+    // If set, `Solve` (as well as `SolveLimited` and `SolveAsync`) calls this as soon as each cell is proven, so that
+    // deductions can be shown before the call completes. Cells not reported by the end of a `kUnknown` call are not
+    // proven either way.
+    std::function<void(const CellDeduction&)> on_cell;
+};
+
+struct SolveResult {
+    enum Status {
+        kSolved,
+        kNoAnswer,
+        // The budget is exceeded before the call completes
+        kUnknown,
+    };
+
+    Status status;
+    // With `kSolved`, the answer (as returned by `FindAnswer` or `Solve`). With `kUnknown` in `SolveLimited`, the cells
+    // proven to be common to all answers before the budget is exceeded, or nullopt if not even the first answer is
+    // found.
+    std::optional<EvolminoAnswer> answer;
+};
+
+struct UniquenessResult {
+    enum Status {
+        kNoAnswer,
+        kUnique,
+        kMultiple,
+        // The budget is exceeded before the call completes
+        kUnknown,
+    };
+
+    Status status;
+    // An answer (unless `kNoAnswer`, or `kUnknown` before any answer is found) and another one (only if `kMultiple`),
+    // without undecided cells
+    std::optional<EvolminoAnswer> first, second;
+};
+
+std::optional<EvolminoAnswer> FindAnswer(const Problem& problem, const SolverOptions& options = SolverOptions());
+std::optional<EvolminoAnswer> Solve(const Problem& problem, const SolverOptions& options = SolverOptions());
+
+// Same as `FindAnswer` and `Solve`, but stop with `SolveResult::kUnknown` when `budget` is exceeded
+SolveResult FindAnswerLimited(const Problem& problem, const SolveBudget& budget,
+                              const SolverOptions& options = SolverOptions());
+SolveResult SolveLimited(const Problem& problem, const SolveBudget& budget,
+                         const SolverOptions& options = SolverOptions());
+
+// Determines whether `problem` has no answer, exactly one, or more. This stops at the second answer, so it is much
+// cheaper than `Solve` when only uniqueness matters.
+UniquenessResult CheckUniqueness(const Problem& problem, const SolverOptions& options = SolverOptions());
+
+// Same as `CheckUniqueness`, but stop with `UniquenessResult::kUnknown` when `budget` is exceeded
+UniquenessResult CheckUniquenessLimited(const Problem& problem, const SolveBudget& budget,
+                                        const SolverOptions& options = SolverOptions());
+
+// Runs `SolveLimited` on `executor` (see `StartSolveAsync`). The objects pointed to by `options` must outlive the call.
+SolveHandle<SolveResult> SolveAsync(const Problem& problem, const SolverOptions& options = SolverOptions(),
+                                    const SolveBudget& budget = SolveBudget(), const Executor& executor = nullptr);
 
 }